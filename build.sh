@@ -1,31 +1,46 @@
 #!/bin/bash
 
 cflags="-Wall -O3 -g -std=gnu11 -fno-strict-aliasing -Isrc"
-lflags="-lSDL2 -lm"
+lflags="-lm"
+
+if [[ $* == *headless* ]]; then
+  cflags="$cflags -DLITE_HEADLESS"
+fi
 
 if [[ $* == *windows* ]]; then
   platform="windows"
   outfile="lite.exe"
   compiler="x86_64-w64-mingw32-gcc"
-  cflags="$cflags -DLUA_USE_POPEN -Iwinlib/SDL2-2.0.10/x86_64-w64-mingw32/include"
-  lflags="$lflags -Lwinlib/SDL2-2.0.10/x86_64-w64-mingw32/lib"
-  lflags="-lmingw32 -lSDL2main $lflags -mwindows -o $outfile res.res"
+  cflags="$cflags -DLUA_USE_POPEN"
+  lflags="-lmingw32 $lflags -luser32 -lgdi32 -lopengl32 -lole32 -mwindows -o $outfile res.res"
   x86_64-w64-mingw32-windres res.rc -O coff -o res.res
 else
-  platform="unix"
+  platform="unix (headless)"
   outfile="lite"
   compiler="gcc"
   cflags="$cflags -DLUA_USE_POSIX"
-  lflags="$lflags -o $outfile"
+  lflags="$lflags -lpthread -o $outfile"
 fi
 
+sources=`find src -name "*.c"`
+
+for tool in replay rastercheck bigframe rectcheck runcheck; do
+  if [[ $* == *$tool* ]]; then
+    # the tools in tools/, built as lite-<name>; they have no use for Lua
+    sources="`find src -name "*.c" ! -name main.c ! -path "src/api/*" ! -path "src/lib/lua52/*"` tools/$tool.c"
+    cflags="$cflags -DLITE_HEADLESS"
+    lflags="${lflags/-o $outfile/-o lite-$tool}"
+    outfile="lite-$tool"
+  fi
+done
+
 if command -v ccache >/dev/null; then
   compiler="ccache $compiler"
 fi
 
 
 echo "compiling ($platform)..."
-for f in `find src -name "*.c"`; do
+for f in $sources; do
   $compiler -c $cflags $f -o "${f//\//_}.o"
   if [[ $? -ne 0 ]]; then
     got_error=true
@@ -52,8 +52,10 @@ local function perform(name)
 end
 
 
-function command.perform(...)
-  local ok, res = core.try(perform, ...)
+function command.perform(name, ...)
+  local trace = system.trace_begin(name)
+  local ok, res = core.try(perform, name, ...)
+  system.trace_end(trace)
   return not ok or res
 end
 
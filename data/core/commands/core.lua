@@ -1,5 +1,6 @@
 local core = require "core"
 local common = require "core.common"
+local config = require "core.config"
 local command = require "core.command"
 local keymap = require "core.keymap"
 local LogView = require "core.logview"
@@ -98,4 +99,45 @@ command.add(nil, {
       doc:save(filename)
     end
   end,
+
+  ["core:toggle-trace"] = function()
+    config.trace = not config.trace
+    system.set_trace_enabled(config.trace)
+    core.log("Tracing %s", config.trace and "started" or "stopped")
+  end,
+
+  ["core:save-trace"] = function()
+    if not config.trace then
+      core.error("Tracing is off, start it with \"Core: Toggle Trace\"")
+      return
+    end
+    core.command_view:set_text("trace.json")
+    core.command_view:enter("Save Trace As", function(filename)
+      local ok, err = system.save_trace(filename)
+      if ok then
+        core.log("Saved trace to \"%s\"", filename)
+      else
+        core.error("%s", err)
+      end
+    end, common.path_suggest)
+  end,
+
+  ["core:toggle-render-capture"] = function()
+    if core.capture_file then
+      renderer.stop_capture()
+      core.log("Saved render capture to \"%s\"", core.capture_file)
+      core.capture_file = nil
+      return
+    end
+    core.command_view:set_text("frames.lcap")
+    core.command_view:enter("Capture Frames To", function(filename)
+      local ok, err = renderer.start_capture(filename)
+      if ok then
+        core.capture_file = filename
+        core.log("Capturing frames to \"%s\"", filename)
+      else
+        core.error("%s", err)
+      end
+    end, common.path_suggest)
+  end,
 })
@@ -128,7 +128,9 @@ end
 
 function common.bench(name, fn, ...)
   local start = system.get_time()
+  local trace = system.trace_begin(name)
   local res = fn(...)
+  system.trace_end(trace)
   local t = system.get_time() - start
   local ms = t * 1000
   local per = (t / (1 / 60)) * 100
@@ -1,5 +1,4 @@
 local core = require "core"
-local config = require "core.config"
 local tokenizer = require "core.tokenizer"
 local Object = require "core.object"
 
@@ -15,8 +14,9 @@ function Highlighter:new(doc)
   core.add_thread(function()
     while true do
       if self.first_invalid_line > self.max_wanted_line then
+        -- sleep until wake() finds there's work
         self.max_wanted_line = 0
-        coroutine.yield(1 / config.fps)
+        coroutine.yield(math.huge)
 
       else
         local max = math.min(self.first_invalid_line + 40, self.max_wanted_line)
@@ -45,9 +45,18 @@ function Highlighter:reset()
 end
 
 
+local function wake(self)
+  if self.first_invalid_line <= self.max_wanted_line then
+    local thread = core.threads[self]
+    if thread then thread.wake = 0 end
+  end
+end
+
+
 function Highlighter:invalidate(idx)
   self.first_invalid_line = math.min(self.first_invalid_line, idx)
   self.max_wanted_line = math.min(self.max_wanted_line, #self.doc.lines)
+  wake(self)
 end
 
 
@@ -67,7 +76,10 @@ function Highlighter:get_line(idx)
     line = self:tokenize_line(idx, prev and prev.state)
     self.lines[idx] = line
   end
-  self.max_wanted_line = math.max(self.max_wanted_line, idx)
+  if idx > self.max_wanted_line then
+    self.max_wanted_line = idx
+    wake(self)
+  end
   return line
 end
 
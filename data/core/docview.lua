@@ -58,6 +58,7 @@ function DocView:new(doc)
   self.font = "code_font"
   self.last_x_offset = {}
   self.blink_timer = 0
+  self.blink_start = system.get_time()
 end
 
 
@@ -143,19 +144,7 @@ end
 
 function DocView:get_x_offset_col(line, x)
   local text = self.doc.lines[line]
-
-  local xoffset, last_i, i = 0, 1, 1
-  for char in common.utf8_chars(text) do
-    local w = self:get_font():get_width(char)
-    if xoffset >= x then
-      return (xoffset - x > w / 2) and last_i or i
-    end
-    xoffset = xoffset + w
-    last_i = i
-    i = i + #char
-  end
-
-  return #text
+  return self:get_font():get_col(text, x)
 end
 
 
@@ -229,7 +218,7 @@ function DocView:on_mouse_pressed(button, x, y, clicks)
     self.doc:set_selection(mouse_selection(self.doc, clicks, line, col, line, col))
     self.mouse_selecting = { line, col, clicks = clicks }
   end
-  self.blink_timer = 0
+  self.blink_timer, self.blink_start = 0, system.get_time()
 end
 
 
@@ -269,18 +258,22 @@ function DocView:update()
     if core.active_view == self then
       self:scroll_to_make_visible(line, col)
     end
-    self.blink_timer = 0
+    self.blink_timer, self.blink_start = 0, system.get_time()
     self.last_line, self.last_col = line, col
   end
 
-  -- update blink timer
-  if self == core.active_view and not self.mouse_selecting then
+  -- update blink timer, waking the main loop for the next blink as it
+  -- otherwise sleeps until there's input; the caret isn't drawn unfocused
+  if self == core.active_view and not self.mouse_selecting
+  and system.window_has_focus() then
     local n = blink_period / 2
     local prev = self.blink_timer
-    self.blink_timer = (self.blink_timer + 1 / config.fps) % blink_period
+    local now = system.get_time()
+    self.blink_timer = (now - self.blink_start) % blink_period
     if (self.blink_timer > n) ~= (prev > n) then
-      core.redraw = true
+      self:invalidate()
     end
+    core.wake_at(now + n - self.blink_timer % n)
   end
 
   DocView.super.update(self)
@@ -295,11 +288,8 @@ end
 
 function DocView:draw_line_text(idx, x, y)
   local tx, ty = x, y + self:get_line_text_y_offset()
-  local font = self:get_font()
-  for _, type, text in self.doc.highlighter:each_token(idx) do
-    local color = style.syntax[type]
-    tx = renderer.draw_text(font, text, tx, ty, color)
-  end
+  local tokens = self.doc.highlighter:get_line(idx).tokens
+  renderer.draw_tokens(self:get_font(), tokens, tx, ty, style.syntax)
 end
 
 
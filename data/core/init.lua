@@ -100,8 +100,12 @@ function core.init()
   core.log_items = {}
   core.docs = {}
   core.threads = setmetatable({}, { __mode = "k" })
+  core.event_buffer = {}
   core.project_files = {}
   core.redraw = true
+  core.redraw_views = false
+  core.retain_views = false
+  core.next_wake = math.huge
 
   core.root_view = RootView()
   core.command_view = CommandView()
@@ -115,6 +119,8 @@ function core.init()
   local got_plugin_error = not core.load_plugins()
   local got_user_error = not core.try(require, "user")
   local got_project_error = not core.load_project_module()
+  system.set_trace_enabled(config.trace)
+  renderer.set_glyph_cache_dir(config.glyph_cache_dir)
 
   for _, filename in ipairs(files) do
     core.root_view:open_doc(core.open_doc(filename))
@@ -225,7 +231,18 @@ end
 function core.add_thread(f, weak_ref)
   local key = weak_ref or #core.threads + 1
   local fn = function() return core.try(f) end
-  core.threads[key] = { cr = coroutine.create(fn), wake = 0 }
+  local info = debug.getinfo(f, "S")
+  local src = info.short_src:match("[^/\\]*$")
+  local name = string.format("thread %s:%d", src, info.linedefined)
+  core.threads[key] = { cr = coroutine.create(fn), wake = 0, name = name }
+end
+
+
+function core.wake_at(time)
+  -- when nothing needs redrawing the main loop sleeps until there's input or
+  -- a thread is due; anything that changes over time on its own calls this
+  -- from its update() so a frame runs by `time`
+  core.next_wake = math.min(core.next_wake, time)
 end
 
 
@@ -363,31 +380,57 @@ function core.step()
   local did_keymap = false
   local mouse_moved = false
   local mouse = { x = 0, y = 0, dx = 0, dy = 0 }
+  local text
 
-  for type, a,b,c,d in system.poll_event do
+  local trace = system.trace_begin("events")
+  local events = core.event_buffer
+  for i = 1, system.poll_events(events) * 5, 5 do
+    local type, a,b,c,d = events[i], events[i+1], events[i+2], events[i+3], events[i+4]
     if type == "mousemoved" then
       mouse_moved = true
       mouse.x, mouse.y = a, b
       mouse.dx, mouse.dy = mouse.dx + c, mouse.dy + d
-    elseif type == "textinput" and did_keymap then
-      did_keymap = false
+    elseif type == "textinput" then
+      -- the text comes a character at a time between each key's press and
+      -- release, so is held back until an event that could act on it comes
+      -- along, making a burst of typing a single edit. The first character
+      -- after a key handled by the keymap was that key's own, so is dropped
+      if did_keymap then
+        a = a:gsub("^[%z\1-\127\194-\244][\128-\191]*", "")
+        did_keymap = false
+      end
+      if a ~= "" then text = (text or "") .. a end
     else
+      if text and type ~= "keyreleased"
+      and not (type == "keypressed" and not keymap.is_bound(a)) then
+        core.try(core.on_event, "textinput", text)
+        text = nil
+      end
       local _, res = core.try(core.on_event, type, a, b, c, d)
       did_keymap = res or did_keymap
     end
     core.redraw = true
   end
+  if text then
+    core.try(core.on_event, "textinput", text)
+  end
   if mouse_moved then
     core.try(core.on_event, "mousemoved", mouse.x, mouse.y, mouse.dx, mouse.dy)
   end
+  system.trace_end(trace)
 
   local width, height = renderer.get_size()
 
   -- update
   core.root_view.size.x, core.root_view.size.y = width, height
+  trace = system.trace_begin("update")
   core.root_view:update()
-  if not core.redraw then return false end
-  core.redraw = false
+  system.trace_end(trace)
+  if not core.redraw and not core.redraw_views then return false end
+  -- unless core.redraw was set, views that didn't invalidate themselves
+  -- reuse what they drew last frame
+  core.retain_views = not core.redraw
+  core.redraw, core.redraw_views = false, false
 
   -- close unreferenced docs
   for i = #core.docs, 1, -1 do
@@ -407,11 +450,13 @@ function core.step()
   end
 
   -- draw
+  trace = system.trace_begin("draw")
   renderer.begin_frame()
   core.clip_rect_stack[1] = { 0, 0, width, height }
   renderer.set_clip_rect(table.unpack(core.clip_rect_stack[1]))
   core.root_view:draw()
   renderer.end_frame()
+  system.trace_end(trace)
   return true
 end
 
@@ -424,7 +469,9 @@ local run_threads = coroutine.wrap(function()
     for k, thread in pairs(core.threads) do
       -- run thread
       if thread.wake < system.get_time() then
+        local trace = system.trace_begin(thread.name)
         local _, wait = assert(coroutine.resume(thread.cr))
+        system.trace_end(trace)
         if coroutine.status(thread.cr) == "dead" then
           if type(k) == "number" then
             table.remove(core.threads, k)
@@ -451,13 +498,25 @@ end)
 function core.run()
   while true do
     core.frame_start = system.get_time()
+    core.next_wake = math.huge
+    local trace = system.trace_begin("frame")
     local did_redraw = core.step()
+    local trace_threads = system.trace_begin("threads")
     run_threads()
-    if not did_redraw and not system.window_has_focus() then
-      system.wait_event(0.25)
+    system.trace_end(trace_threads)
+    system.trace_end(trace)
+    local frame_end = core.frame_start + 1 / config.fps
+    if did_redraw or core.redraw or core.redraw_views then
+      system.sleep(math.max(0, frame_end - system.get_time()))
+    else
+      -- idle: sleep until the next thread or core.wake_at() deadline, or input
+      local wake = core.next_wake
+      for _, thread in pairs(core.threads) do
+        wake = math.min(wake, thread.wake)
+      end
+      local timeout = math.max(wake, frame_end) - system.get_time()
+      if timeout > 0 then system.wait_event(timeout) end
     end
-    local elapsed = system.get_time() - core.frame_start
-    system.sleep(math.max(0, 1 / config.fps - elapsed))
   end
 end
 
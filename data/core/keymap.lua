@@ -52,6 +52,12 @@ function keymap.get_binding(cmd)
 end
 
 
+function keymap.is_bound(k)
+  -- whether pressing `k` now would be handled by on_key_pressed()
+  return keymap.map[key_to_stroke(k)] ~= nil
+end
+
+
 function keymap.on_key_pressed(k)
   local mk = modkey_map[k]
   if mk then
@@ -40,6 +40,22 @@ end
 
 
 
+local trace_names = setmetatable({}, { __mode = "k" })
+
+local function trace_name(view)
+  -- draw spans are named after where the view's draw() is defined, as threads
+  -- are, so view classes don't need to name themselves
+  local name = trace_names[view.draw]
+  if not name then
+    local info = debug.getinfo(view.draw, "S")
+    local src = info.short_src:match("[^/\\]*$")
+    name = string.format("draw %s:%d", src, info.linedefined)
+    trace_names[view.draw] = name
+  end
+  return name
+end
+
+
 local Node = Object:extend()
 
 function Node:new(type)
@@ -359,6 +375,24 @@ function Node:draw_tabs()
 end
 
 
+function Node:scroll_region()
+  -- if the same view was drawn at the same place last frame and its content
+  -- only moved vertically, the renderer can move last frame's pixels along
+  -- instead of redrawing them all. Returns true if nothing moved
+  local view = self.active_view
+  local x, y, w, h = table.unpack(core.clip_rect_stack[#core.clip_rect_stack])
+  local ox, oy = view:get_content_offset()
+  local last = self.last_drawn
+  local same = last and last.view == view and last.x == x and last.y == y
+    and last.w == w and last.h == h and last.ox == ox
+  if same and last.oy ~= oy then
+    renderer.scroll_region(x, y, w, h, oy - last.oy)
+  end
+  self.last_drawn = { view = view, x = x, y = y, w = w, h = h, ox = ox, oy = oy }
+  return same and last.oy == oy
+end
+
+
 function Node:draw()
   if self.type == "leaf" then
     if #self.views > 1 then
@@ -366,7 +400,21 @@ function Node:draw()
     end
     local pos, size = self.active_view.position, self.active_view.size
     core.push_clip_rect(pos.x, pos.y, size.x + pos.x % 1, size.y + pos.y % 1)
-    self.active_view:draw()
+    local view = self.active_view
+    local unmoved = self:scroll_region()
+    -- the view is drawn as a layer, so a view that hasn't moved or
+    -- invalidated itself can have its last commands issued again instead
+    local x, y, w, h = table.unpack(core.clip_rect_stack[#core.clip_rect_stack])
+    local id = view.layer_id
+    if not (core.retain_views and unmoved and not view.invalid
+    and renderer.replay_layer(id, x, y, w, h)) then
+      renderer.begin_layer(id, x, y, w, h)
+      local trace = system.trace_begin(trace_name(view))
+      view:draw()
+      system.trace_end(trace)
+      renderer.end_layer()
+    end
+    view.invalid = false
     core.pop_clip_rect()
   else
     local x, y, w, h = self:get_divider_rect()
@@ -8,7 +8,12 @@ local Object = require "core.object"
 local View = Object:extend()
 
 
+local layer_count = 0
+
 function View:new()
+  -- each view draws into a renderer layer of its own, see Node:draw()
+  layer_count = layer_count + 1
+  self.layer_id = layer_count
   self.position = { x = 0, y = 0 }
   self.size = { x = 0, y = 0 }
   self.scroll = { x = 0, y = 0, to = { x = 0, y = 0 } }
@@ -28,11 +33,19 @@ function View:move_towards(t, k, dest, rate)
     t[k] = common.lerp(val, dest, rate or 0.5)
   end
   if val ~= dest then
-    core.redraw = true
+    self:invalidate()
   end
 end
 
 
+function View:invalidate()
+  -- redraws only this view on the next frame, while core.redraw redraws them
+  -- all; for changes that don't show outside the view
+  self.invalid = true
+  core.redraw_views = true
+end
+
+
 function View:try_close(do_close)
   do_close()
 end
@@ -1,6 +1,8 @@
+#include <stdlib.h>
 #include "api.h"
 #include "renderer.h"
 #include "rencache.h"
+#include "workers.h"
 
 
 static RenColor checkcolor(lua_State *L, int idx, int def) {
@@ -60,6 +62,47 @@ static int f_set_clip_rect(lua_State *L) {
 }
 
 
+static int f_scroll_region(lua_State *L) {
+  RenRect rect;
+  rect.x = luaL_checknumber(L, 1);
+  rect.y = luaL_checknumber(L, 2);
+  rect.width = luaL_checknumber(L, 3);
+  rect.height = luaL_checknumber(L, 4);
+  rencache_scroll_region(rect, luaL_checknumber(L, 5));
+  return 0;
+}
+
+
+static int f_begin_layer(lua_State *L) {
+  int id = luaL_checknumber(L, 1);
+  RenRect rect;
+  rect.x = luaL_checknumber(L, 2);
+  rect.y = luaL_checknumber(L, 3);
+  rect.width = luaL_checknumber(L, 4);
+  rect.height = luaL_checknumber(L, 5);
+  rencache_begin_layer(id, rect);
+  return 0;
+}
+
+
+static int f_replay_layer(lua_State *L) {
+  int id = luaL_checknumber(L, 1);
+  RenRect rect;
+  rect.x = luaL_checknumber(L, 2);
+  rect.y = luaL_checknumber(L, 3);
+  rect.width = luaL_checknumber(L, 4);
+  rect.height = luaL_checknumber(L, 5);
+  lua_pushboolean(L, rencache_replay_layer(id, rect));
+  return 1;
+}
+
+
+static int f_end_layer(lua_State *L) {
+  rencache_end_layer();
+  return 0;
+}
+
+
 static int f_draw_rect(lua_State *L) {
   RenRect rect;
   rect.x = luaL_checknumber(L, 1);
@@ -84,15 +127,185 @@ static int f_draw_text(lua_State *L) {
 }
 
 
+static int f_draw_tokens(lua_State *L) {
+  /* takes a flat { type, text, type, text, ... } list of tokens and a table
+  ** of colors by type; colors are looked up once per distinct type */
+  static RenToken *tokens;
+  static int cap;
+  const char *types[16];
+  RenColor colors[16];
+  int type_count = 0;
+
+  RenFont **font = luaL_checkudata(L, 1, API_TYPE_FONT);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  int x = luaL_checknumber(L, 3);
+  int y = luaL_checknumber(L, 4);
+  luaL_checktype(L, 5, LUA_TTABLE);
+
+  int count = lua_rawlen(L, 2) / 2;
+  if (count > cap) {
+    cap = count;
+    tokens = realloc(tokens, cap * sizeof(RenToken));
+    if (!tokens) { cap = 0; return luaL_error(L, "out of memory"); }
+  }
+
+  for (int i = 0; i < count; i++) {
+    lua_rawgeti(L, 2, i * 2 + 1);
+    lua_rawgeti(L, 2, i * 2 + 2);
+    size_t len;
+    tokens[i].text = luaL_checklstring(L, -1, &len);
+    tokens[i].len = len;
+
+    /* strings stay alive in the tokens table; equal short strings are the
+    ** same object, so types can be compared by pointer */
+    const char *type = luaL_checkstring(L, -2);
+    int j = 0;
+    while (j < type_count && types[j] != type) { j++; }
+    if (j < type_count) {
+      tokens[i].color = colors[j];
+    } else {
+      lua_pushvalue(L, -2);
+      lua_rawget(L, 5);
+      tokens[i].color = checkcolor(L, lua_gettop(L), 255);
+      lua_pop(L, 1);
+      if (type_count < 16) {
+        types[type_count] = type;
+        colors[type_count++] = tokens[i].color;
+      }
+    }
+    lua_pop(L, 2);
+  }
+
+  x = rencache_draw_tokens(*font, tokens, count, x, y);
+  lua_pushnumber(L, x);
+  return 1;
+}
+
+
+static int f_set_glyph_cache_limit(lua_State *L) {
+  ren_set_glyph_cache_limit(luaL_checknumber(L, 1));
+  return 0;
+}
+
+
+static int f_set_text_run_cache_limit(lua_State *L) {
+  ren_set_text_run_cache_limit(luaL_checknumber(L, 1));
+  return 0;
+}
+
+
+static int f_set_cell_size(lua_State *L) {
+  rencache_set_cell_size(luaL_optnumber(L, 1, 0));
+  return 0;
+}
+
+
+static int f_show_heatmap(lua_State *L) {
+  luaL_checkany(L, 1);
+  rencache_show_heatmap(lua_toboolean(L, 1));
+  return 0;
+}
+
+
+static void set_field(lua_State *L, const char *name, double value) {
+  lua_pushnumber(L, value);
+  lua_setfield(L, -2, name);
+}
+
+
+static int f_get_stats(lua_State *L) {
+  /* frame values are for the last frame, the rest are totals since startup */
+  RenCacheStats fs;
+  RenStats rs;
+  rencache_get_stats(&fs);
+  ren_get_stats(&rs);
+  lua_newtable(L);
+  set_field(L, "unchanged",         fs.unchanged);
+  set_field(L, "cell_size",         fs.cell_size);
+  set_field(L, "commands",          fs.commands);
+  set_field(L, "command_bytes",     fs.command_bytes);
+  set_field(L, "command_capacity",  fs.command_capacity);
+  set_field(L, "commands_replayed", fs.commands_replayed);
+  set_field(L, "cells_changed",     fs.cells_changed);
+  set_field(L, "rects",             fs.rects);
+  set_field(L, "rect_area",         fs.rect_area);
+  set_field(L, "wasted_ratio",      fs.wasted_ratio);
+  set_field(L, "scrolled_area",     fs.scrolled_area);
+  set_field(L, "layers",            fs.layers);
+  set_field(L, "layers_clean",      fs.layers_clean);
+  set_field(L, "layers_replayed",   fs.layers_replayed);
+  set_field(L, "hash_time",         fs.hash_time);
+  set_field(L, "draw_time",         fs.draw_time);
+  set_field(L, "present_time",      fs.present_time);
+  set_field(L, "pixels_filled",     rs.pixels_filled);
+  set_field(L, "pixels_blended",    rs.pixels_blended);
+  set_field(L, "pixels_text",       rs.pixels_text);
+  set_field(L, "glyphs_loaded",     rs.glyphs_loaded);
+  set_field(L, "glyphs_rasterized", rs.glyphs_rasterized);
+  set_field(L, "glyphs_from_disk",  rs.glyphs_from_disk);
+  set_field(L, "pages_evicted",     rs.pages_evicted);
+  set_field(L, "text_run_hits",     rs.text_run_hits);
+  set_field(L, "text_run_misses",   rs.text_run_misses);
+  set_field(L, "width_hits",        rs.width_hits);
+  set_field(L, "width_misses",      rs.width_misses);
+  set_field(L, "width_fixed",       rs.width_fixed);
+  return 1;
+}
+
+
+static int f_set_thread_count(lua_State *L) {
+  workers_set_count(luaL_checknumber(L, 1));
+  return 0;
+}
+
+
+static int f_start_capture(lua_State *L) {
+  const char *filename = luaL_checkstring(L, 1);
+  if (!rencache_start_capture(filename)) {
+    lua_pushnil(L);
+    lua_pushfstring(L, "could not open capture file '%s'", filename);
+    return 2;
+  }
+  lua_pushboolean(L, 1);
+  return 1;
+}
+
+
+static int f_stop_capture(lua_State *L) {
+  rencache_stop_capture();
+  return 0;
+}
+
+
+static int f_set_glyph_cache_dir(lua_State *L) {
+  ren_set_glyph_cache_dir(lua_toboolean(L, 1) ? luaL_checkstring(L, 1) : NULL);
+  return 0;
+}
+
+
 static const luaL_Reg lib[] = {
-  { "show_debug",    f_show_debug    },
-  { "get_size",      f_get_size      },
-  { "begin_frame",   f_begin_frame   },
-  { "end_frame",     f_end_frame     },
-  { "set_clip_rect", f_set_clip_rect },
-  { "draw_rect",     f_draw_rect     },
-  { "draw_text",     f_draw_text     },
-  { NULL,            NULL            }
+  { "show_debug",               f_show_debug               },
+  { "show_heatmap",             f_show_heatmap             },
+  { "get_size",                 f_get_size                 },
+  { "get_stats",                f_get_stats                },
+  { "begin_frame",              f_begin_frame              },
+  { "end_frame",                f_end_frame                },
+  { "set_clip_rect",            f_set_clip_rect            },
+  { "scroll_region",            f_scroll_region            },
+  { "begin_layer",              f_begin_layer              },
+  { "end_layer",                f_end_layer                },
+  { "replay_layer",             f_replay_layer             },
+  { "draw_rect",                f_draw_rect                },
+  { "draw_text",                f_draw_text                },
+  { "draw_tokens",              f_draw_tokens              },
+  { "set_glyph_cache_limit",    f_set_glyph_cache_limit    },
+  { "set_glyph_cache_dir",      f_set_glyph_cache_dir      },
+  { "set_text_run_cache_limit", f_set_text_run_cache_limit },
+  { "set_thread_count",         f_set_thread_count         },
+  { "set_cell_size",            f_set_cell_size            },
+  { "start_capture",            f_start_capture            },
+  { "stop_capture",             f_stop_capture             },
+  { NULL,                       NULL                       }
 };
 
 
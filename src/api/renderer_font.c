@@ -37,6 +37,15 @@ static int f_get_width(lua_State *L) {
 }
 
 
+static int f_get_col(lua_State *L) {
+  RenFont **self = luaL_checkudata(L, 1, API_TYPE_FONT);
+  const char *text = luaL_checkstring(L, 2);
+  double x = luaL_checknumber(L, 3);
+  lua_pushnumber(L, ren_get_font_col(*self, text, x) );
+  return 1;
+}
+
+
 static int f_get_height(lua_State *L) {
   RenFont **self = luaL_checkudata(L, 1, API_TYPE_FONT);
   lua_pushnumber(L, ren_get_font_height(*self) );
@@ -49,6 +58,7 @@ static const luaL_Reg lib[] = {
   { "load",          f_load          },
   { "set_tab_width", f_set_tab_width },
   { "get_width",     f_get_width     },
+  { "get_col",       f_get_col       },
   { "get_height",    f_get_height    },
   { NULL, NULL }
 };
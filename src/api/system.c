@@ -1,3 +1,6 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <ctype.h>
 #include <dirent.h>
@@ -7,14 +10,12 @@
 #include "api.h"
 #include "rencache.h"
 #include "event.h"
+#include "trace.h"
+#include "platform/platform.h"
 
-#define WIND32_MEAN_AND_LEAN
-#include <windows.h>
-
-
-extern HWND hwnd;
-
-extern wchar_t * to_wstr(const char * in, int * text_length);
+#ifdef _WIN32
+  #include <windows.h>
+#endif
 
 
 static const char* button_name(int button) {
@@ -27,20 +28,7 @@ static const char* button_name(int button) {
 }
 
 
-static char* key_name(char *dst, int sym) {
-  /*
-  strcpy(dst, SDL_GetKeyName(sym));
-  char *p = dst;
-  while (*p) {
-    *p = tolower(*p);
-    p++;
-  }
-  */
-  return dst;
-}
-
-static int process_events(lua_State *L) {
-  event_t event = event_pop();
+static int push_event(lua_State *L, event_t event) {
   switch (event.type)
   {
     case EVENT_RESIZE:
@@ -87,144 +75,60 @@ static int process_events(lua_State *L) {
       lua_pushstring(L, event.keyreleased.name);
       return 2;
 
-    case EVENT_TEXTINPUT:
-      {
-        char text[32];
-        sprintf(text, "%c", event.textinput.ch);
-        lua_pushstring(L, "textinput");
-        lua_pushstring(L, text);
-        return 2;
-      }
-  }
-  return 0;
-}
-
-static int f_poll_event(lua_State *L) {
-  char buf[16];
-  int mx, my, wx, wy;
-  //SDL_Event e;
-  MSG msg;
-
-  if (event_has())
-    return process_events(L);
-
-  while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
-  {
-    if (msg.message == WM_QUIT)
-    {
+    case EVENT_QUIT:
       lua_pushstring(L, "quit");
       return 1;
-    }
-
-    TranslateMessage(&msg);
-    DispatchMessage(&msg);
-  }
-
-  return process_events(L);
 
-
-#if 0
-  if ( !SDL_PollEvent(&e) ) {
-    return 0;
-  }
-  switch (e.type) {
-    case SDL_QUIT:
-      lua_pushstring(L, "quit");
+    case EVENT_FOCUS:
+      lua_pushstring(L, event.focus.gained ? "focusgained" : "focuslost");
       return 1;
 
-    case SDL_WINDOWEVENT:
-      if (e.window.event == SDL_WINDOWEVENT_RESIZED) {
-        lua_pushstring(L, "resized");
-        lua_pushnumber(L, e.window.data1);
-        lua_pushnumber(L, e.window.data2);
-        return 3;
-      } else if (e.window.event == SDL_WINDOWEVENT_EXPOSED) {
-        rencache_invalidate();
-        lua_pushstring(L, "exposed");
-        return 1;
-      }
-      /* on some systems, when alt-tabbing to the window SDL will queue up
-      ** several KEYDOWN events for the `tab` key; we flush all keydown
-      ** events on focus so these are discarded */
-      if (e.window.event == SDL_WINDOWEVENT_FOCUS_GAINED) {
-        SDL_FlushEvent(SDL_KEYDOWN);
-      }
-      goto top;
-
-    case SDL_DROPFILE:
-      SDL_GetGlobalMouseState(&mx, &my);
-      SDL_GetWindowPosition(window, &wx, &wy);
-      lua_pushstring(L, "filedropped");
-      lua_pushstring(L, e.drop.file);
-      lua_pushnumber(L, mx - wx);
-      lua_pushnumber(L, my - wy);
-      SDL_free(e.drop.file);
-      return 4;
-
-    case SDL_KEYDOWN:
-      lua_pushstring(L, "keypressed");
-      lua_pushstring(L, key_name(buf, e.key.keysym.sym));
-      return 2;
-
-    case SDL_KEYUP:
-      lua_pushstring(L, "keyreleased");
-      lua_pushstring(L, key_name(buf, e.key.keysym.sym));
-      return 2;
-
-    case SDL_TEXTINPUT:
+    case EVENT_TEXTINPUT:
       lua_pushstring(L, "textinput");
-      lua_pushstring(L, e.text.text);
+      lua_pushstring(L, event.textinput.text);
       return 2;
+  }
+  return 0;
+}
 
-    case SDL_MOUSEBUTTONDOWN:
-      if (e.button.button == 1) { SDL_CaptureMouse(1); }
-      lua_pushstring(L, "mousepressed");
-      lua_pushstring(L, button_name(e.button.button));
-      lua_pushnumber(L, e.button.x);
-      lua_pushnumber(L, e.button.y);
-      lua_pushnumber(L, e.button.clicks);
-      return 5;
-
-    case SDL_MOUSEBUTTONUP:
-      if (e.button.button == 1) { SDL_CaptureMouse(0); }
-      lua_pushstring(L, "mousereleased");
-      lua_pushstring(L, button_name(e.button.button));
-      lua_pushnumber(L, e.button.x);
-      lua_pushnumber(L, e.button.y);
-      return 4;
-
-    case SDL_MOUSEMOTION:
-      lua_pushstring(L, "mousemoved");
-      lua_pushnumber(L, e.motion.x);
-      lua_pushnumber(L, e.motion.y);
-      lua_pushnumber(L, e.motion.xrel);
-      lua_pushnumber(L, e.motion.yrel);
-      return 5;
+static int f_poll_event(lua_State *L) {
+  if (!event_has()) {
+    platform_poll_events();
+  }
+  return push_event(L, event_pop());
+}
 
-    case SDL_MOUSEWHEEL:
-      lua_pushstring(L, "mousewheel");
-      lua_pushnumber(L, e.wheel.y);
-      return 2;
 
-    default:
-      goto top;
+static int f_poll_events(lua_State *L) {
+  /* polls the platform once, then drains every queued event into the table
+  ** as flat groups of five values (type, a, b, c, d), unused ones nil, and
+  ** returns the number of events. The table can be reused between calls as
+  ** every slot used is written. A window's platform takes all its pending
+  ** messages in one poll; the headless one runs a script line per poll, so
+  ** each line's events get a step of their own */
+  luaL_checktype(L, 1, LUA_TTABLE);
+  int count = 0;
+  platform_poll_events();
+  while (event_has()) {
+    int n = push_event(L, event_pop());
+    for (; n < 5; n++) { lua_pushnil(L); }
+    for (int i = 5; i > 0; i--) {
+      lua_rawseti(L, 1, count * 5 + i);
+    }
+    count++;
   }
-  #endif
-
-  return 0;
+  lua_pushinteger(L, count);
+  return 1;
 }
 
 
 static int f_wait_event(lua_State *L) {
   double n = luaL_checknumber(L, 1);
-  //lua_pushboolean(L, SDL_WaitEventTimeout(NULL, n * 1000));
-  lua_pushboolean(L, 0);
+  lua_pushboolean(L, platform_wait_event(n));
   return 1;
 }
 
 
-//static SDL_Cursor* cursor_cache[SDL_SYSTEM_CURSOR_HAND + 1];
-
 static const char *cursor_opts[] = {
   "arrow",
   "ibeam",
@@ -234,58 +138,30 @@ static const char *cursor_opts[] = {
   NULL
 };
 
-static const int cursor_enums[] = {
-  1,
-  2,
-  3,
-  4,
-  5
-  //SDL_SYSTEM_CURSOR_ARROW,
-  //SDL_SYSTEM_CURSOR_IBEAM,
-  //SDL_SYSTEM_CURSOR_SIZEWE,
-  //SDL_SYSTEM_CURSOR_SIZENS,
-  //SDL_SYSTEM_CURSOR_HAND
-};
-
 static int f_set_cursor(lua_State *L) {
   int opt = luaL_checkoption(L, 1, "arrow", cursor_opts);
-  int n = cursor_enums[opt];
-  /*
-  SDL_Cursor *cursor = cursor_cache[n];
-  if (!cursor) {
-    cursor = SDL_CreateSystemCursor(n);
-    cursor_cache[n] = cursor;
-  }
-  SDL_SetCursor(cursor);
-  */
+  platform_set_cursor(opt);
   return 0;
 }
 
 
 static int f_set_window_title(lua_State *L) {
-  wchar_t * wtitle = to_wstr(luaL_checkstring(L, 1), NULL);
-  SetWindowTextW(hwnd, wtitle);
-  free(wtitle);
-
+  platform_set_window_title(luaL_checkstring(L, 1));
   return 0;
 }
 
 
 static const char *window_opts[] = { "normal", "maximized", "fullscreen", 0 };
-enum { WIN_NORMAL, WIN_MAXIMIZED, WIN_FULLSCREEN };
 
 static int f_set_window_mode(lua_State *L) {
   int n = luaL_checkoption(L, 1, "normal", window_opts);
-
-  if (n == WIN_NORMAL) ShowWindow(hwnd, SW_RESTORE);
-  if (n == WIN_MAXIMIZED || n == WIN_FULLSCREEN) ShowWindow(hwnd, SW_MAXIMIZE);
-
+  platform_set_window_mode(n);
   return 0;
 }
 
 
 static int f_window_has_focus(lua_State *L) {
-  lua_pushboolean(L, GetFocus() == hwnd);
+  lua_pushboolean(L, platform_window_has_focus());
   return 1;
 }
 
@@ -293,28 +169,7 @@ static int f_window_has_focus(lua_State *L) {
 static int f_show_confirm_dialog(lua_State *L) {
   const char *title = luaL_checkstring(L, 1);
   const char *msg = luaL_checkstring(L, 2);
-
-#if _WIN32
-  int id = MessageBox(0, msg, title, MB_YESNO | MB_ICONWARNING);
-  lua_pushboolean(L, id == IDYES);
-
-#else
-/*
-  SDL_MessageBoxButtonData buttons[] = {
-    { SDL_MESSAGEBOX_BUTTON_RETURNKEY_DEFAULT, 1, "Yes" },
-    { SDL_MESSAGEBOX_BUTTON_ESCAPEKEY_DEFAULT, 0, "No" },
-  };
-  SDL_MessageBoxData data = {
-    .title = title,
-    .message = msg,
-    .numbuttons = 2,
-    .buttons = buttons,
-  };
-  int buttonid;
-  SDL_ShowMessageBox(&data, &buttonid);
-  lua_pushboolean(L, buttonid == 1);
-*/
-#endif
+  lua_pushboolean(L, platform_show_confirm_dialog(title, msg));
   return 1;
 }
 
@@ -401,40 +256,30 @@ static int f_get_file_info(lua_State *L) {
 
 
 static int f_get_clipboard(lua_State *L) {
-  return 0;
-/*
-  char *text = SDL_GetClipboardText();
+  char *text = platform_get_clipboard();
   if (!text) { return 0; }
   lua_pushstring(L, text);
-  SDL_free(text);
+  free(text);
   return 1;
-*/
 }
 
 
 static int f_set_clipboard(lua_State *L) {
   const char *text = luaL_checkstring(L, 1);
-  //SDL_SetClipboardText(text);
+  platform_set_clipboard(text);
   return 0;
 }
 
 
 static int f_get_time(lua_State *L) {
-  LARGE_INTEGER time, frequency;
-  QueryPerformanceCounter(&time);
-  QueryPerformanceFrequency(&frequency);
-  double n = time.QuadPart / (double)frequency.QuadPart;
-
-  //double n = SDL_GetPerformanceCounter() / (double) SDL_GetPerformanceFrequency();
-  lua_pushnumber(L, n);
+  lua_pushnumber(L, platform_get_time());
   return 1;
 }
 
 
 static int f_sleep(lua_State *L) {
   double n = luaL_checknumber(L, 1);
-  Sleep(n * 1000);
-  //SDL_Delay(n * 1000);
+  platform_sleep(n);
   return 0;
 }
 
@@ -483,8 +328,39 @@ static int f_fuzzy_match(lua_State *L) {
 }
 
 
+static int f_set_trace_enabled(lua_State *L) {
+  trace_set_enabled(lua_toboolean(L, 1));
+  return 0;
+}
+
+
+static int f_trace_begin(lua_State *L) {
+  lua_pushnumber(L, trace_begin(luaL_checkstring(L, 1)));
+  return 1;
+}
+
+
+static int f_trace_end(lua_State *L) {
+  trace_end(luaL_checknumber(L, 1));
+  return 0;
+}
+
+
+static int f_save_trace(lua_State *L) {
+  const char *filename = luaL_checkstring(L, 1);
+  if (!trace_write(filename)) {
+    lua_pushnil(L);
+    lua_pushfstring(L, "could not write trace to '%s'", filename);
+    return 2;
+  }
+  lua_pushboolean(L, 1);
+  return 1;
+}
+
+
 static const luaL_Reg lib[] = {
   { "poll_event",          f_poll_event          },
+  { "poll_events",         f_poll_events         },
   { "wait_event",          f_wait_event          },
   { "set_cursor",          f_set_cursor          },
   { "set_window_title",    f_set_window_title    },
@@ -501,6 +377,10 @@ static const luaL_Reg lib[] = {
   { "sleep",               f_sleep               },
   { "exec",                f_exec                },
   { "fuzzy_match",         f_fuzzy_match         },
+  { "set_trace_enabled",   f_set_trace_enabled   },
+  { "trace_begin",         f_trace_begin         },
+  { "trace_end",           f_trace_end           },
+  { "save_trace",          f_save_trace          },
   { NULL, NULL }
 };
 
@@ -0,0 +1,43 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+/* the format of the files written by rencache_start_capture() and replayed by
+** tools/replay.c. After the CAPTURE_MAGIC bytes the file is a list of records,
+** each a tag byte followed by its fields: ints are 32 bits, rects are four ints
+** (x, y, width, height), colors four bytes (b, g, r, a) and strings an int
+** length followed by that many bytes. Numbers are in the byte order of the
+** machine that wrote the file.
+**
+**   CAP_FONT        index, size (a float), filename
+**   CAP_FREE_FONT   index
+**   CAP_FRAME       width, height
+**   CAP_SCROLL      rect, dy
+**   CAP_CLIP        rect
+**   CAP_RECT        rect, color
+**   CAP_TEXT        font index, x, y, color, tab width, text
+**   CAP_TOKENS      font index, x, y, tab width, count, count * (color, text)
+**   CAP_LAYER       id, rect
+**   CAP_LAYER_END
+**   CAP_END_FRAME
+**
+** A frame's records come between CAP_FRAME and CAP_END_FRAME, in the order
+** they were issued, with its scrolled regions first. A font is defined before
+** its first use, and its index can be used for another font once it's freed */
+
+#define CAPTURE_MAGIC "LITECAP1"
+
+enum {
+  CAP_FONT      = 'f',
+  CAP_FREE_FONT = 'x',
+  CAP_FRAME     = 'F',
+  CAP_SCROLL    = 's',
+  CAP_CLIP      = 'c',
+  CAP_RECT      = 'r',
+  CAP_TEXT      = 't',
+  CAP_TOKENS    = 'k',
+  CAP_LAYER     = 'l',
+  CAP_LAYER_END = 'e',
+  CAP_END_FRAME = 'E',
+};
+
+#endif
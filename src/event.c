@@ -1,30 +1,77 @@
-
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
 #include "event.h"
 
+/* a ring of events that doubles in size when it fills up, so a burst of input
+** is never dropped. Runs of mouse moves and resizes are folded into the last
+** queued event as they're pushed, as only the latest position or size matters.
+** Text input isn't joined here: a platform queues each key's press and release
+** around its text, so the runs are joined by core.step as it reads them.
+** Events are pushed from the platform layer while it's polling, which happens
+** on the same thread that pops them, so no locking is needed */
 
-static event_t event_queue[16];
-static int head;
-static int tail;
+static event_t *event_queue;
+static unsigned capacity; /* always a power of two */
+static unsigned head;
+static unsigned tail;
 static event_t nil_event = {0};
 
 
+static void grow(void) {
+  unsigned new_capacity = capacity ? capacity * 2 : 64;
+  event_t *queue = malloc(new_capacity * sizeof(event_t));
+  if (!queue) {
+    fprintf(stderr, "Fatal error: memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  unsigned count = head - tail;
+  for (unsigned i = 0; i < count; i++) {
+    queue[i] = event_queue[(tail + i) & (capacity - 1)];
+  }
+  free(event_queue);
+  event_queue = queue;
+  capacity = new_capacity;
+  tail = 0;
+  head = count;
+}
+
+
+static bool coalesce(event_t event) {
+  if (head == tail) { return false; }
+  event_t *last = &event_queue[(head - 1) & (capacity - 1)];
+  if (last->type != event.type) { return false; }
+
+  switch (event.type) {
+    case EVENT_MOUSEMOVED:
+      last->mousemoved.x = event.mousemoved.x;
+      last->mousemoved.y = event.mousemoved.y;
+      last->mousemoved.xrel += event.mousemoved.xrel;
+      last->mousemoved.yrel += event.mousemoved.yrel;
+      return true;
+
+    case EVENT_RESIZE:
+      last->resize = event.resize;
+      return true;
+  }
+  return false;
+}
 
 
 int event_has(void) {
   return head != tail;
 }
 
+
 void event_push(event_t event) {
-  event_queue[head] = event;
-  head = (head + 1) % 16;
+  if (coalesce(event)) { return; }
+  if (head - tail == capacity) { grow(); }
+  event_queue[head & (capacity - 1)] = event;
+  head++;
 }
 
-event_t event_pop(void) {
-  if (head == tail)
-    return nil_event;
 
-  int old_tail = tail;
-  tail = (tail + 1) % 16;
-  return event_queue[old_tail];
+event_t event_pop(void) {
+  if (head == tail) { return nil_event; }
+  return event_queue[tail++ & (capacity - 1)];
 }
-
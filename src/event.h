@@ -13,6 +13,8 @@
 #define EVENT_TEXTINPUT     6
 #define EVENT_KEYPRESSED    7
 #define EVENT_KEYRELEASED   8
+#define EVENT_QUIT          9
+#define EVENT_FOCUS         10
 
 struct resize_t {
   int width;
@@ -44,7 +46,7 @@ struct mouse_moved_t {
 };
 
 struct textinput_t {
-  char ch;
+  char text[32]; /* utf-8 */
 };
 
 struct keypressed_t {
@@ -55,6 +57,10 @@ struct keyreleased_t {
   char name[32];
 };
 
+struct focus_t {
+  int gained;
+};
+
 typedef struct event_t {
   int type;
   union {
@@ -66,6 +72,7 @@ typedef struct event_t {
     struct textinput_t     textinput;
     struct keypressed_t    keypressed;
     struct keyreleased_t   keyreleased;
+    struct focus_t         focus;
   };
 } event_t;
 
@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <sys/stat.h>
+#endif
+
+#include "glyphcache.h"
+#include "mapfile.h"
+
+/* file layout: a Header, `count` GlyphCacheEntry sorted by codepoint, then the
+** coverage of each glyph, `width * height` bytes without padding */
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  uint64_t face_hash;
+  float size, scale;
+  uint32_t count;
+  uint32_t reserved;
+} Header;
+
+typedef struct {
+  GlyphCacheEntry entry;
+  const uint8_t *coverage;
+} SaveItem;
+
+struct GlyphCache {
+  char *filename;
+  uint64_t face_hash;
+  float size, scale;
+  int refs;                   /* fonts using it */
+  /* the mapped file, if there was a valid one */
+  uint8_t *data;
+  size_t data_size;
+  const GlyphCacheEntry *entries;
+  int count;
+  /* glyphs rasterized since, offsets are into `added_data` */
+  GlyphCacheEntry *added;
+  int added_count, added_cap;
+  uint8_t *added_data;
+  size_t added_size, added_data_cap;
+  struct GlyphCache *next;
+};
+
+static char *cache_dir;
+static GlyphCache *caches;
+
+
+static void* check_alloc(void *ptr) {
+  if (!ptr) {
+    fprintf(stderr, "Fatal error: memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  return ptr;
+}
+
+
+static bool valid_header(GlyphCache *cache) {
+  const Header *h = (const Header*) cache->data;
+  return cache->data_size >= sizeof(Header)
+    && !memcmp(h->magic, "LGC\0", 4)
+    && h->version == GLYPH_CACHE_VERSION
+    && h->face_hash == cache->face_hash
+    && h->size == cache->size
+    && h->scale == cache->scale
+    && h->count <= (cache->data_size - sizeof(Header)) / sizeof(GlyphCacheEntry);
+}
+
+
+static void unmap(GlyphCache *cache) {
+  if (cache->data) { unmap_file(cache->data, cache->data_size); }
+  cache->data = NULL;
+  cache->entries = NULL;
+  cache->count = 0;
+}
+
+
+static int compare_items(const void *a, const void *b) {
+  uint32_t x = ((const SaveItem*) a)->entry.codepoint;
+  uint32_t y = ((const SaveItem*) b)->entry.codepoint;
+  return (x > y) - (x < y);
+}
+
+
+static bool write_file(const char *filename, SaveItem *items, int count, Header *h) {
+  FILE *fp = fopen(filename, "wb");
+  if (!fp) { return false; }
+  uint32_t offset = sizeof(Header) + count * sizeof(GlyphCacheEntry);
+  h->count = count;
+  bool ok = fwrite(h, sizeof(*h), 1, fp) == 1;
+  for (int i = 0; i < count && ok; i++) {
+    GlyphCacheEntry e = items[i].entry;
+    e.offset = offset;
+    offset += e.width * e.height;
+    ok = fwrite(&e, sizeof(e), 1, fp) == 1;
+  }
+  for (int i = 0; i < count && ok; i++) {
+    size_t n = items[i].entry.width * items[i].entry.height;
+    ok = fwrite(items[i].coverage, 1, n, fp) == n;
+  }
+  return (fclose(fp) == 0) && ok;
+}
+
+
+/* merges the mapped glyphs with the ones added since and replaces the file.
+** The cache is empty afterwards; glyphs that were already looked up keep their
+** metrics and are rasterized by the font again if they are ever evicted */
+static void save(GlyphCache *cache) {
+  if (cache->added_count == 0) { return; }
+
+  int count = 0;
+  SaveItem *items = check_alloc(malloc(
+    (cache->count + cache->added_count) * sizeof(SaveItem)));
+  for (int i = 0; i < cache->count; i++) {
+    const GlyphCacheEntry *e = &cache->entries[i];
+    if (e->offset + (size_t) e->width * e->height > cache->data_size) { continue; }
+    items[count++] = (SaveItem) { *e, cache->data + e->offset };
+  }
+  for (int i = 0; i < cache->added_count; i++) {
+    const GlyphCacheEntry *e = &cache->added[i];
+    items[count++] = (SaveItem) { *e, cache->added_data + e->offset };
+  }
+  qsort(items, count, sizeof(SaveItem), compare_items);
+
+  /* keep the first of any duplicate codepoints */
+  int n = 0;
+  for (int i = 0; i < count; i++) {
+    if (n == 0 || items[i].entry.codepoint != items[n - 1].entry.codepoint) {
+      items[n++] = items[i];
+    }
+  }
+
+  Header h = { .magic = "LGC", .version = GLYPH_CACHE_VERSION,
+               .face_hash = cache->face_hash, .size = cache->size,
+               .scale = cache->scale };
+  char *tmp = check_alloc(malloc(strlen(cache->filename) + 5));
+  sprintf(tmp, "%s.tmp", cache->filename);
+#ifdef _WIN32
+  CreateDirectoryA(cache_dir, NULL);
+#else
+  mkdir(cache_dir, 0755);
+#endif
+  bool ok = write_file(tmp, items, n, &h);
+  free(items);
+
+  /* the old file must be unmapped before it can be replaced on windows */
+  unmap(cache);
+  if (ok) {
+#ifdef _WIN32
+    ok = MoveFileExA(tmp, cache->filename, MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = rename(tmp, cache->filename) == 0;
+#endif
+  }
+  if (!ok) {
+    fprintf(stderr, "Warning: (" __FILE__ "): could not write glyph cache '%s'\n",
+      cache->filename);
+    remove(tmp);
+  }
+  free(tmp);
+
+  free(cache->added);
+  free(cache->added_data);
+  cache->added = NULL;
+  cache->added_data = NULL;
+  cache->added_count = cache->added_cap = 0;
+  cache->added_size = cache->added_data_cap = 0;
+}
+
+
+static void save_all(void) {
+  for (GlyphCache *c = caches; c; c = c->next) { save(c); }
+}
+
+
+void glyph_cache_set_dir(const char *dir) {
+  static bool registered;
+  free(cache_dir);
+  cache_dir = dir ? check_alloc(strdup(dir)) : NULL;
+  if (cache_dir && !registered) {
+    atexit(save_all);
+    registered = true;
+  }
+}
+
+
+bool glyph_cache_enabled(void) {
+  return cache_dir != NULL;
+}
+
+
+uint64_t glyph_cache_hash(const void *data, size_t size) {
+  /* fnv-1a */
+  const uint8_t *p = data;
+  uint64_t h = 14695981039346656037ull;
+  while (size--) {
+    h = (h ^ *p++) * 1099511628211ull;
+  }
+  return h;
+}
+
+
+GlyphCache* glyph_cache_open(uint64_t face_hash, float size, float scale) {
+  if (!cache_dir) { return NULL; }
+  int len = snprintf(NULL, 0, "%s/%016" PRIx64 "-%d.glyphs",
+    cache_dir, face_hash, (int) (size * 64));
+  char *filename = check_alloc(malloc(len + 1));
+  sprintf(filename, "%s/%016" PRIx64 "-%d.glyphs",
+    cache_dir, face_hash, (int) (size * 64));
+
+  /* fonts loaded more than once share a cache, as they'd save to the same
+  ** file and the last one saved would drop the glyphs of the others */
+  for (GlyphCache *c = caches; c; c = c->next) {
+    if (!strcmp(c->filename, filename)) {
+      free(filename);
+      c->refs++;
+      return c;
+    }
+  }
+
+  GlyphCache *cache = check_alloc(calloc(1, sizeof(GlyphCache)));
+  cache->filename = filename;
+  cache->face_hash = face_hash;
+  cache->size = size;
+  cache->scale = scale;
+  cache->refs = 1;
+
+  cache->data = map_file(cache->filename, &cache->data_size);
+  if (cache->data && valid_header(cache)) {
+    cache->entries = (const GlyphCacheEntry*) (cache->data + sizeof(Header));
+    cache->count = ((const Header*) cache->data)->count;
+  } else {
+    unmap(cache);
+  }
+
+  cache->next = caches;
+  caches = cache;
+  return cache;
+}
+
+
+void glyph_cache_close(GlyphCache *cache) {
+  if (--cache->refs > 0) { return; }
+  save(cache);
+  unmap(cache);
+  GlyphCache **c = &caches;
+  while (*c != cache) { c = &(*c)->next; }
+  *c = cache->next;
+  free(cache->filename);
+  free(cache);
+}
+
+
+const uint8_t* glyph_cache_find(GlyphCache *cache, unsigned codepoint, GlyphCacheEntry *entry) {
+  int lo = 0, hi = cache->count - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    const GlyphCacheEntry *e = &cache->entries[mid];
+    if (e->codepoint < codepoint) { lo = mid + 1; continue; }
+    if (e->codepoint > codepoint) { hi = mid - 1; continue; }
+    if (e->width < 0 || e->height < 0 ||
+        e->offset + (size_t) e->width * e->height > cache->data_size) {
+      return NULL;
+    }
+    *entry = *e;
+    return cache->data + e->offset;
+  }
+  return NULL;
+}
+
+
+void glyph_cache_add(GlyphCache *cache, GlyphCacheEntry entry, const uint8_t *coverage, int stride) {
+  size_t n = entry.width * entry.height;
+  if (cache->added_count == cache->added_cap) {
+    cache->added_cap = cache->added_cap ? cache->added_cap * 2 : 128;
+    cache->added = check_alloc(realloc(cache->added,
+      cache->added_cap * sizeof(GlyphCacheEntry)));
+  }
+  while (cache->added_size + n > cache->added_data_cap) {
+    cache->added_data_cap = cache->added_data_cap ? cache->added_data_cap * 2 : 16384;
+    cache->added_data = check_alloc(realloc(cache->added_data, cache->added_data_cap));
+  }
+  entry.offset = cache->added_size;
+  for (int j = 0; j < entry.height; j++) {
+    memcpy(cache->added_data + cache->added_size, coverage + j * stride, entry.width);
+    cache->added_size += entry.width;
+  }
+  cache->added[cache->added_count++] = entry;
+}
@@ -0,0 +1,37 @@
+#ifndef GLYPHCACHE_H
+#define GLYPHCACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* optional on-disk cache of rasterized glyphs. Once a directory is set, every
+** font loaded afterwards gets a file there, keyed by the hash of the font file,
+** the pixel size and GLYPH_CACHE_VERSION, holding the metrics and 8bit
+** coverage of each glyph it has rasterized; fonts with the same key share one
+** GlyphCache. The file is memory mapped when the font is loaded and rewritten
+** with the newly rasterized glyphs when the last font using it is freed or
+** the program exits. Bump GLYPH_CACHE_VERSION whenever rasterized output
+** changes */
+
+#define GLYPH_CACHE_VERSION 1
+
+typedef struct {
+  uint32_t codepoint;
+  uint32_t offset;            /* of the coverage, from the start of the file */
+  int16_t width, height;
+  int16_t xoff, yoff;
+  int32_t xadvance;
+} GlyphCacheEntry;
+
+typedef struct GlyphCache GlyphCache;
+
+void glyph_cache_set_dir(const char *dir);
+bool glyph_cache_enabled(void);
+uint64_t glyph_cache_hash(const void *data, size_t size);
+GlyphCache* glyph_cache_open(uint64_t face_hash, float size, float scale);
+void glyph_cache_close(GlyphCache *cache);
+const uint8_t* glyph_cache_find(GlyphCache *cache, unsigned codepoint, GlyphCacheEntry *entry);
+void glyph_cache_add(GlyphCache *cache, GlyphCacheEntry entry, const uint8_t *coverage, int stride);
+
+#endif
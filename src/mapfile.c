@@ -0,0 +1,51 @@
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+#include "mapfile.h"
+
+
+void* map_file(const char *filename, size_t *size) {
+#ifdef _WIN32
+  HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) { return NULL; }
+  LARGE_INTEGER file_size;
+  HANDLE mapping = NULL;
+  if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  }
+  CloseHandle(file);
+  if (!mapping) { return NULL; }
+  void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  *size = file_size.QuadPart;
+  return data;
+#else
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) { return NULL; }
+  struct stat st;
+  void *data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (data == MAP_FAILED) { return NULL; }
+  *size = st.st_size;
+  return data;
+#endif
+}
+
+
+void unmap_file(void *data, size_t size) {
+#ifdef _WIN32
+  UnmapViewOfFile(data);
+#else
+  munmap(data, size);
+#endif
+}
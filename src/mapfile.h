@@ -0,0 +1,11 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <stddef.h>
+
+/* maps a whole file read-only into memory; returns NULL if the file can't be
+** opened or is empty */
+void* map_file(const char *filename, size_t *size);
+void unmap_file(void *data, size_t size);
+
+#endif
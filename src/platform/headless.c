@@ -0,0 +1,381 @@
+#if !defined(_WIN32) || defined(LITE_HEADLESS)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "platform.h"
+#include "event.h"
+
+/* a backend without a window: frames are rendered into the back buffer and
+** never shown, the clipboard is kept in memory and input is read from the
+** script file named by LITE_HEADLESS_SCRIPT, one event per line:
+**
+**   resize <w> <h>              keypressed <name>     keyreleased <name>
+**   key <name>                  text <string>         mousewheel <delta>
+**   mousemoved <x> <y>          mousepressed <button> <x> <y> [clicks]
+**   mousereleased <button> <x> <y>                    clipboard <string>
+**   wait <seconds>              steps <n>             screenshot <file.ppm>
+**   present <max pixels>        quit
+**
+** `wait` and `steps` hold back the rest of the script until the given time
+** has passed or the main loop has polled for events the given number of
+** times without getting any (i.e. ran that many more frames). The window size
+** is taken from LITE_HEADLESS_SIZE (e.g. "1920x1080"). Like a real backend
+** it keeps its own copy of the screen and only copies in the rects it's given
+** on present, so a screenshot shows any change the renderer failed to mark
+** dirty. `present` exits with a failure status unless some frame since the
+** last `present` line uploaded pixels and none uploaded more than the given
+** number. A summary of frame times and present bandwidth is printed to stderr
+** on exit */
+
+static int window_width = 1280;
+static int window_height = 800;
+static FILE *script;
+static double script_wait_until;
+static int script_wait_steps;
+static int steps;
+static char *clipboard;
+
+static RenColor *front;
+static int front_width, front_height;
+
+static struct {
+  double start_time;
+  double frame_start;
+  double frame_total;
+  double frame_max;
+  int frames;
+  double uploaded, screen;
+  int rects;
+  /* since the last `present` script line */
+  int check_presents, check_max;
+} stats;
+
+
+static int button_id(const char *name) {
+  if (!strcmp(name, "left"  )) { return 1; }
+  if (!strcmp(name, "middle")) { return 2; }
+  if (!strcmp(name, "right" )) { return 3; }
+  return 0;
+}
+
+
+static void write_screenshot(const char *filename) {
+  if (!front) { return; }
+  FILE *fp = fopen(filename, "wb");
+  if (!fp) { return; }
+  fprintf(fp, "P6\n%d %d\n255\n", front_width, front_height);
+  for (int i = 0; i < front_width * front_height; i++) {
+    RenColor c = front[i];
+    fputc(c.r, fp);
+    fputc(c.g, fp);
+    fputc(c.b, fp);
+  }
+  fclose(fp);
+}
+
+
+static void push_key(int type, const char *name) {
+  event_t event = { .type = type };
+  snprintf(event.keypressed.name, sizeof(event.keypressed.name), "%s", name);
+  event_push(event);
+}
+
+
+static void run_script_line(char *line) {
+  char name[256], arg[256];
+  int a, b, c;
+  double n;
+
+  line[strcspn(line, "\r\n")] = '\0';
+  if (sscanf(line, "%255s", name) != 1 || name[0] == '#') { return; }
+  const char *rest = line + strspn(line, " \t");
+  rest += strlen(name);
+  rest += strspn(rest, " \t");
+
+  if (!strcmp(name, "resize") && sscanf(rest, "%d %d", &a, &b) == 2) {
+    ren_resize(a, b);
+    event_t event = { .type = EVENT_RESIZE, .resize.width = a, .resize.height = b };
+    event_push(event);
+
+  } else if (!strcmp(name, "keypressed")) {
+    push_key(EVENT_KEYPRESSED, rest);
+
+  } else if (!strcmp(name, "keyreleased")) {
+    push_key(EVENT_KEYRELEASED, rest);
+
+  } else if (!strcmp(name, "key")) {
+    push_key(EVENT_KEYPRESSED, rest);
+    push_key(EVENT_KEYRELEASED, rest);
+
+  } else if (!strcmp(name, "text")) {
+    /* one event per utf-8 character, like a platform would push them */
+    for (const char *p = rest; *p;) {
+      event_t event = { .type = EVENT_TEXTINPUT };
+      int n = 1;
+      while ((p[n] & 0xc0) == 0x80 && n < 4) { n++; }
+      memcpy(event.textinput.text, p, n);
+      event_push(event);
+      p += n;
+    }
+
+  } else if (!strcmp(name, "mousewheel") && sscanf(rest, "%d", &a) == 1) {
+    event_t event = { .type = EVENT_MOUSEWHEEL, .mousewheel.delta = a };
+    event_push(event);
+
+  } else if (!strcmp(name, "mousemoved") && sscanf(rest, "%d %d", &a, &b) == 2) {
+    static int last_x, last_y;
+    event_t event = { .type = EVENT_MOUSEMOVED, .mousemoved.x = a, .mousemoved.y = b,
+                      .mousemoved.xrel = a - last_x, .mousemoved.yrel = b - last_y };
+    last_x = a;
+    last_y = b;
+    event_push(event);
+
+  } else if (!strcmp(name, "mousepressed") && sscanf(rest, "%255s %d %d", arg, &a, &b) == 3) {
+    if (sscanf(rest, "%*s %*d %*d %d", &c) != 1) { c = 1; }
+    event_t event = { .type = EVENT_MOUSEPRESS, .mousepress.button = button_id(arg),
+                      .mousepress.x = a, .mousepress.y = b, .mousepress.clicks = c };
+    event_push(event);
+
+  } else if (!strcmp(name, "mousereleased") && sscanf(rest, "%255s %d %d", arg, &a, &b) == 3) {
+    event_t event = { .type = EVENT_MOUSERELEASE, .mouserelease.button = button_id(arg),
+                      .mouserelease.x = a, .mouserelease.y = b };
+    event_push(event);
+
+  } else if (!strcmp(name, "clipboard")) {
+    platform_set_clipboard(rest);
+
+  } else if (!strcmp(name, "wait") && sscanf(rest, "%lf", &n) == 1) {
+    script_wait_until = platform_get_time() + n;
+
+  } else if (!strcmp(name, "steps") && sscanf(rest, "%d", &a) == 1) {
+    script_wait_steps = steps + a;
+
+  } else if (!strcmp(name, "screenshot")) {
+    write_screenshot(rest);
+
+  } else if (!strcmp(name, "present") && sscanf(rest, "%d", &a) == 1) {
+    if (stats.check_presents == 0 || stats.check_max > a) {
+      fprintf(stderr, "headless: present check failed: %d frames uploaded pixels, "
+        "at most %d in one frame, expected at most %d\n",
+        stats.check_presents, stats.check_max, a);
+      exit(EXIT_FAILURE);
+    }
+    stats.check_presents = 0;
+    stats.check_max = 0;
+
+  } else if (!strcmp(name, "quit")) {
+    event_t event = { .type = EVENT_QUIT };
+    event_push(event);
+
+  } else {
+    fprintf(stderr, "Warning: (" __FILE__ "): bad script line '%s'\n", line);
+  }
+}
+
+
+static bool script_blocked(void) {
+  return platform_get_time() < script_wait_until || steps < script_wait_steps;
+}
+
+
+static void run_script(void) {
+  /* stop after the first line that queues something so each line's events
+  ** are handled before the next line runs, rather than being coalesced with
+  ** them */
+  char line[1024];
+  while (script && !script_blocked() && !event_has()) {
+    if (!fgets(line, sizeof(line), script)) {
+      fclose(script);
+      script = NULL;
+      event_t event = { .type = EVENT_QUIT };
+      event_push(event);
+      break;
+    }
+    run_script_line(line);
+  }
+}
+
+
+static void print_stats(void) {
+  double elapsed = platform_get_time() - stats.start_time;
+  fprintf(stderr, "headless: %d frames in %.3fs, frame avg %.3fms max %.3fms",
+    stats.frames, elapsed,
+    stats.frames ? stats.frame_total / stats.frames * 1000.0 : 0.0,
+    stats.frame_max * 1000.0);
+  fprintf(stderr, ", uploaded %.1f%% of pixels in %d rects",
+    stats.screen > 0 ? stats.uploaded / stats.screen * 100.0 : 0.0, stats.rects);
+#ifndef _WIN32
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    fprintf(stderr, ", max rss %ldkb", usage.ru_maxrss);
+  }
+#endif
+  fprintf(stderr, "\n");
+}
+
+
+bool platform_init(int *width, int *height) {
+  const char *size = getenv("LITE_HEADLESS_SIZE");
+  if (size) {
+    sscanf(size, "%dx%d", &window_width, &window_height);
+  }
+
+  const char *filename = getenv("LITE_HEADLESS_SCRIPT");
+  if (filename) {
+    script = fopen(filename, "r");
+    if (!script) {
+      fprintf(stderr, "Error: (" __FILE__ "): could not open script '%s'\n", filename);
+      return false;
+    }
+  }
+
+  stats.start_time = platform_get_time();
+  stats.frame_start = stats.start_time;
+  atexit(print_stats);
+
+  *width = window_width;
+  *height = window_height;
+  return true;
+}
+
+
+void platform_close(void) {
+  if (script) { fclose(script); }
+  script = NULL;
+}
+
+
+const char* platform_get_name(void) {
+  return "headless";
+}
+
+
+double platform_get_scale(void) {
+  return 1.0;
+}
+
+
+void platform_poll_events(void) {
+  /* frames are timed from the last poll before a present, so a step that
+  ** didn't draw, and the wait after it, isn't counted in the next frame */
+  stats.frame_start = platform_get_time();
+  run_script();
+  if (!event_has()) { steps++; }
+}
+
+
+bool platform_wait_event(double timeout) {
+  double deadline = platform_get_time() + timeout;
+  for (;;) {
+    run_script();
+    double now = platform_get_time();
+    if (event_has() || now >= deadline) { break; }
+    /* a script waiting for steps counts main loop iterations, so those can't
+    ** block; one only waiting for time to pass wakes up early */
+    if (script && steps < script_wait_steps) { break; }
+    double until = deadline;
+    if (script && now < script_wait_until && script_wait_until < deadline) {
+      until = script_wait_until;
+    }
+    platform_sleep(fmin(until - now, 1.0));
+  }
+  return event_has();
+}
+
+
+static void copy_rect(const RenColor *pixels, RenRect r) {
+  for (int y = r.y; y < r.y + r.height; y++) {
+    memcpy(front + r.x + y * front_width, pixels + r.x + y * front_width,
+      r.width * sizeof(RenColor));
+  }
+}
+
+
+void platform_present(const RenColor *pixels, int width, int height,
+  const RenRect *rects, int count) {
+  int uploaded = 0;
+  if (width != front_width || height != front_height) {
+    free(front);
+    front = malloc(width * height * sizeof(RenColor));
+    front_width = width;
+    front_height = height;
+    count = 0;
+    copy_rect(pixels, (RenRect) { 0, 0, width, height });
+    uploaded += width * height;
+    stats.rects++;
+  }
+  for (int i = 0; i < count; i++) {
+    copy_rect(pixels, rects[i]);
+    uploaded += rects[i].width * rects[i].height;
+  }
+  stats.uploaded += uploaded;
+  stats.rects += count;
+  stats.screen += width * height;
+  if (uploaded > 0) {
+    stats.check_presents++;
+    if (uploaded > stats.check_max) { stats.check_max = uploaded; }
+  }
+
+  double t = platform_get_time() - stats.frame_start;
+  stats.frame_total += t;
+  if (t > stats.frame_max) { stats.frame_max = t; }
+  stats.frames++;
+}
+
+
+void platform_set_cursor(int cursor) {
+}
+
+
+void platform_set_window_title(const char *title) {
+}
+
+
+void platform_set_window_mode(int mode) {
+}
+
+
+bool platform_window_has_focus(void) {
+  return true;
+}
+
+
+bool platform_show_confirm_dialog(const char *title, const char *msg) {
+  return true;
+}
+
+
+char* platform_get_clipboard(void) {
+  return clipboard ? strdup(clipboard) : NULL;
+}
+
+
+void platform_set_clipboard(const char *text) {
+  free(clipboard);
+  clipboard = strdup(text);
+}
+
+
+double platform_get_time(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+void platform_sleep(double seconds) {
+  if (seconds <= 0) { return; }
+  struct timespec ts;
+  ts.tv_sec = seconds;
+  ts.tv_nsec = (seconds - ts.tv_sec) * 1e9;
+  nanosleep(&ts, NULL);
+}
+
+#endif
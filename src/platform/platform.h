@@ -0,0 +1,39 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdbool.h>
+#include "renderer.h"
+
+/* everything that talks to the windowing system lives behind this interface.
+** exactly one backend is compiled in: win32.c on windows, or headless.c on
+** other systems (or when LITE_HEADLESS is defined) which renders offscreen and
+** reads its input from a script */
+
+enum { CURSOR_ARROW, CURSOR_IBEAM, CURSOR_SIZEH, CURSOR_SIZEV, CURSOR_HAND };
+enum { WIN_NORMAL, WIN_MAXIMIZED, WIN_FULLSCREEN };
+
+bool platform_init(int *width, int *height);
+void platform_close(void);
+const char* platform_get_name(void);
+double platform_get_scale(void);
+
+void platform_poll_events(void);
+bool platform_wait_event(double timeout);
+/* shows the back buffer; only `rects` changed since the last call, the
+** backend keeps its own copy of everything else unless the size changed */
+void platform_present(const RenColor *pixels, int width, int height,
+  const RenRect *rects, int count);
+
+void platform_set_cursor(int cursor);
+void platform_set_window_title(const char *title);
+void platform_set_window_mode(int mode);
+bool platform_window_has_focus(void);
+bool platform_show_confirm_dialog(const char *title, const char *msg);
+
+char* platform_get_clipboard(void);
+void platform_set_clipboard(const char *text);
+
+double platform_get_time(void);
+void platform_sleep(double seconds);
+
+#endif
@@ -0,0 +1,746 @@
+#if defined(_WIN32) && !defined(LITE_HEADLESS)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <ctype.h>
+
+#define WIND32_MEAN_AND_LEAN
+#include <windows.h>
+#include <windowsx.h>
+
+#include <GL/gl.h>
+
+#include "platform.h"
+#include "event.h"
+
+typedef char GLchar;
+typedef ptrdiff_t GLintptr;
+typedef ptrdiff_t GLsizeiptr;
+
+#ifndef HINST_THISCOMPONENT
+IMAGE_DOS_HEADER __ImageBase;
+#define HINST_THISCOMPONENT ((HINSTANCE)&__ImageBase)
+#endif
+
+#define GL_LIST \
+    GL_F(void,      BlendEquation,           GLenum mode) \
+    GL_F(void,      ActiveTexture,           GLenum texture)
+
+typedef BOOL WINAPI wglChoosePixelFormatARBF(HDC hdc, const int *piAttribIList, const FLOAT *pfAttribFList, UINT nMaxFormats, int *piFormats, UINT *nNumFormats);
+typedef HGLRC WINAPI wglCreateContextAttribsARBF(HDC hDC, HGLRC hShareContext, const int *attribList);
+
+wglChoosePixelFormatARBF *wglChoosePixelFormatARB = 0;
+wglCreateContextAttribsARBF *wglCreateContextAttribsARB = 0;
+
+#define WGL_DRAW_TO_WINDOW_ARB                  0x2001
+#define WGL_ACCELERATION_ARB                    0x2003
+#define WGL_FULL_ACCELERATION_ARB               0x2027
+#define WGL_SUPPORT_OPENGL_ARB                  0x2010
+#define WGL_DOUBLE_BUFFER_ARB                   0x2011
+#define WGL_PIXEL_TYPE_ARB                      0x2013
+#define WGL_TYPE_RGBA_ARB                       0x202B
+#define WGL_FRAMEBUFFER_SRGB_CAPABLE_ARB        0x20A9
+#define WGL_CONTEXT_MAJOR_VERSION_ARB           0x2091
+#define WGL_CONTEXT_MINOR_VERSION_ARB           0x2092
+#define WGL_CONTEXT_FLAGS_ARB                   0x2094
+#define WGL_CONTEXT_PROFILE_MASK_ARB            0x9126
+#define WGL_CONTEXT_DEBUG_BIT_ARB               0x0001
+#define WGL_CONTEXT_COMPATIBILITY_PROFILE_BIT_ARB 0x00000002
+#define GL_BGRA 0x80E1
+
+// Common functions.
+#define GL_F(ret, name, ...) typedef ret name##proc(__VA_ARGS__); name##proc * gl##name;
+GL_LIST
+#undef GL_F
+
+
+static HWND hwnd;
+static int last_mouse_x = -1;
+static int last_mouse_y = -1;
+static GLuint back_buffer_texture = 0;
+static int texture_width, texture_height;
+
+
+static wchar_t* to_wstr(const char * in, int * text_length)
+{
+   int len = MultiByteToWideChar(CP_UTF8, 0, in, -1, NULL, 0);
+   if (len == 0)
+      return NULL;
+
+   wchar_t * out = malloc(sizeof(wchar_t) * len);
+   MultiByteToWideChar(CP_UTF8, 0, in, -1, out, len);
+
+   if (text_length != NULL)
+      *text_length = len;
+
+   return out;
+}
+
+
+static void handle_key(int down, int key) {
+  char single_char_str[2] = {0};
+  char * name = NULL;
+
+  switch (key) {
+    case VK_SHIFT:
+      name = "left shift";
+      break;
+    case VK_LSHIFT:
+      name = "left shift";
+      break;
+    case VK_RSHIFT:
+      name = "right shift";
+      break;
+    case VK_RETURN:
+      name = "return";
+      break;
+    case VK_ESCAPE:
+      name = "escape";
+      break;
+    case VK_LEFT:
+      name = "left";
+      break;
+    case VK_RIGHT:
+      name = "right";
+      break;
+    case VK_UP:
+      name = "up";
+      break;
+    case VK_DOWN:
+      name = "down";
+      break;
+    case VK_END:
+      name = "end";
+      break;
+    case VK_HOME:
+      name = "home";
+      break;
+    case VK_SPACE:
+      name = "space";
+      break;
+    case VK_BACK:
+      name = "backspace";
+      break;
+    case VK_TAB:
+      name = "tab";
+      break;
+    case VK_PRIOR:
+      name = "pageup";
+      break;
+    case VK_NEXT:
+      name = "pagedown";
+      break;
+    case VK_CONTROL:
+      name = "left ctrl";
+      break;
+    case VK_LCONTROL:
+      name = "left ctrl";
+      break;
+    case VK_RCONTROL:
+      name = "right ctrl";
+      break;
+    case VK_MENU:
+      name = "alt";
+      break;
+    case VK_INSERT:
+      name = "insert";
+      break;
+    case VK_DELETE:
+      name = "delete";
+      break;
+    default:
+      {
+        if ((key >= 48 && key <= 57) || (key >= 65 && key <= 90)) {
+          single_char_str[0] = tolower(key);
+          name = single_char_str;
+        }
+      }
+      break;
+  }
+
+  if (name != NULL) {
+    if (down) {
+      event_t event = { .type = EVENT_KEYPRESSED };
+      strcpy(event.keypressed.name, name);
+      event_push(event);
+    } else {
+      event_t event = { .type = EVENT_KEYRELEASED };
+      strcpy(event.keyreleased.name, name);
+      event_push(event);
+    }
+  }
+}
+
+
+static void draw_back_buffer(void) {
+  /* the texture holds the whole screen, so it can be drawn again whenever
+  ** windows uncovering ours leave it to be repainted */
+  if (texture_width == 0) { return; }
+  int width = texture_width, height = texture_height;
+  glBindTexture(GL_TEXTURE_2D, back_buffer_texture);
+
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT);
+
+  glViewport(0, 0, width, height);
+
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  glOrtho(0.0, width, 0.0, height, 1.0, -1.0);
+  glMatrixMode(GL_MODELVIEW);
+  glLoadIdentity();
+
+  glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 1.0f); glVertex2f(0.0f, 0.0f);
+    glTexCoord2f(1.0f, 1.0f); glVertex2f(width, 0.0f);
+    glTexCoord2f(1.0f, 0.0f); glVertex2f(width, height);
+    glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, height);
+  glEnd();
+
+  HDC dc = GetDC(hwnd);
+  SwapBuffers(dc);
+  ReleaseDC(hwnd, dc);
+}
+
+
+static LRESULT window_proc(HWND hwnd, UINT message, WPARAM w_param, LPARAM l_param) {
+   LRESULT result = 0;
+   BOOL handled = FALSE;
+
+  switch (message) {
+    case WM_CLOSE:
+       DestroyWindow(hwnd);
+       break;
+
+    case WM_DESTROY:
+      PostQuitMessage(0);
+      result = 1;
+      handled = TRUE;
+      break;
+
+    case WM_DISPLAYCHANGE:
+      InvalidateRect(hwnd, NULL, FALSE);
+      result = 0;
+      handled = TRUE;
+      break;
+
+    case WM_PAINT:
+      draw_back_buffer();
+      ValidateRect(hwnd, NULL);
+      result = 0;
+      handled = TRUE;
+      break;
+
+    case WM_SIZE:
+      {
+        event_t event = { .type = EVENT_RESIZE, .resize.width = LOWORD(l_param), .resize.height = HIWORD(l_param) };
+        ren_resize(event.resize.width, event.resize.height);
+        event_push(event);
+        result = 0;
+        handled = TRUE;
+      }
+      break;
+
+    case WM_SETFOCUS:
+    case WM_KILLFOCUS:
+      {
+        /* the caret is only drawn while focused, and the main loop may be
+        ** blocked in platform_wait_event() with nothing else to wake it */
+        event_t event = { .type = EVENT_FOCUS, .focus.gained = message == WM_SETFOCUS };
+        event_push(event);
+        result = 0;
+        handled = TRUE;
+      }
+      break;
+
+    case WM_SYSKEYDOWN:
+    case WM_KEYDOWN:
+      handle_key(1, w_param);
+      result = 0;
+      handled = TRUE;
+      break;
+
+    case WM_SYSKEYUP:
+    case WM_KEYUP:
+      handle_key(0, w_param);
+      result = 0;
+      handled = TRUE;
+      break;
+
+    case WM_MOUSEWHEEL:
+      {
+        event_t event = { .type = EVENT_MOUSEWHEEL, .mousewheel.delta = GET_WHEEL_DELTA_WPARAM(w_param) / WHEEL_DELTA };
+        event_push(event);
+        result = 0;
+        handled = TRUE;
+      }
+      break;
+
+    case WM_LBUTTONDOWN:
+    case WM_RBUTTONDOWN:
+    case WM_MBUTTONDOWN:
+      {
+        event_t event = { .type = EVENT_MOUSEPRESS, .mousepress.x = GET_X_LPARAM(l_param), .mousepress.y = GET_Y_LPARAM(l_param), .mousepress.clicks = 1 };
+
+        switch (message)
+        {
+           case WM_LBUTTONDOWN:
+              SetCapture(hwnd);
+              event.mousepress.button = 1;
+              break;
+
+           case WM_RBUTTONDOWN:
+              event.mousepress.button = 3;
+              break;
+
+           case WM_MBUTTONDOWN:
+              event.mousepress.button = 2;
+              break;
+        }
+
+        event_push(event);
+        result = 0;
+        handled = TRUE;
+      }
+      break;
+
+    case WM_LBUTTONUP:
+    case WM_RBUTTONUP:
+    case WM_MBUTTONUP:
+      {
+        event_t event = { .type = EVENT_MOUSERELEASE, .mouserelease.x = GET_X_LPARAM(l_param), .mouserelease.y = GET_Y_LPARAM(l_param) };
+
+        switch (message)
+        {
+           case WM_LBUTTONUP:
+              ReleaseCapture();
+              event.mouserelease.button = 1;
+              break;
+
+           case WM_RBUTTONUP:
+              event.mouserelease.button = 3;
+              break;
+
+           case WM_MBUTTONUP:
+              event.mouserelease.button = 2;
+              break;
+        }
+
+        event_push(event);
+        result = 0;
+        handled = TRUE;
+      }
+      break;
+
+    case WM_LBUTTONDBLCLK:
+    case WM_RBUTTONDBLCLK:
+      {
+        event_t event = { .type = EVENT_MOUSEPRESS, .mousepress.x = GET_X_LPARAM(l_param), .mousepress.y = GET_Y_LPARAM(l_param), .mousepress.clicks = 2 };
+
+        switch (message)
+        {
+           case WM_LBUTTONDBLCLK:
+              SetCapture(hwnd);
+              event.mousepress.button = 1;
+              break;
+
+           case WM_RBUTTONDBLCLK:
+              event.mousepress.button = 3;
+              break;
+        }
+
+        event_push(event);
+        result = 0;
+        handled = TRUE;
+      }
+      break;
+
+    case WM_MOUSEMOVE:
+      {
+        event_t event = { .type = EVENT_MOUSEMOVED, .mousemoved.x = GET_X_LPARAM(l_param), .mousemoved.y = GET_Y_LPARAM(l_param) };
+
+        if (last_mouse_x == -1) {
+          last_mouse_x = event.mousemoved.x;
+          event.mousemoved.xrel = 0;
+        } else {
+          event.mousemoved.xrel = event.mousemoved.x - last_mouse_x;
+          last_mouse_x = event.mousemoved.x;
+        }
+
+        if (last_mouse_y == -1) {
+          last_mouse_y = event.mousemoved.y;
+          event.mousemoved.yrel = 0;
+        } else {
+          event.mousemoved.yrel = event.mousemoved.y - last_mouse_y;
+          last_mouse_y = event.mousemoved.y;
+        }
+
+        event_push(event);
+        result = 0;
+        handled = TRUE;
+      }
+      break;
+
+    case WM_CHAR:
+      {
+        /* a UTF-16 code unit; characters outside the BMP come as a surrogate
+        ** pair over two messages */
+        static WCHAR high_surrogate;
+        WCHAR ch = (WCHAR)w_param;
+        WCHAR units[2];
+        int count = 0;
+        if (ch >= 0xD800 && ch < 0xDC00) {
+          high_surrogate = ch;
+        } else {
+          if (ch >= 0xDC00 && ch < 0xE000) {
+            if (high_surrogate) {
+              units[count++] = high_surrogate;
+              units[count++] = ch;
+            }
+          } else if (ch >= 32 && ch != 127) {
+            units[count++] = ch;
+          }
+          high_surrogate = 0;
+        }
+        if (count > 0) {
+          event_t event = { .type = EVENT_TEXTINPUT };
+          WideCharToMultiByte(CP_UTF8, 0, units, count, event.textinput.text,
+                              sizeof(event.textinput.text) - 1, NULL, NULL);
+          event_push(event);
+        }
+        result = 0;
+        handled = TRUE;
+      }
+      break;
+  }
+
+  if (!handled)
+    result = DefWindowProcW(hwnd, message, w_param, l_param);
+
+  return result;
+}
+
+
+static int set_window_pixel_format(HDC dc) {
+  int pixel_format = 0;
+  int extended_pixel_format = 0;
+  if (wglChoosePixelFormatARB) {
+    int attrib[] = {
+      WGL_DRAW_TO_WINDOW_ARB, GL_TRUE,
+      WGL_ACCELERATION_ARB, WGL_FULL_ACCELERATION_ARB,
+      WGL_SUPPORT_OPENGL_ARB, GL_TRUE,
+      WGL_DOUBLE_BUFFER_ARB, GL_TRUE,
+      WGL_PIXEL_TYPE_ARB, WGL_TYPE_RGBA_ARB,
+      WGL_FRAMEBUFFER_SRGB_CAPABLE_ARB, GL_TRUE,
+      0,
+    };
+    wglChoosePixelFormatARB(dc, attrib, 0, 1, &pixel_format, &extended_pixel_format);
+  }
+
+  if (!extended_pixel_format) {
+    PIXELFORMATDESCRIPTOR desired_pixel_format_desc = { 0 };
+
+    desired_pixel_format_desc.nSize = sizeof(PIXELFORMATDESCRIPTOR);
+    desired_pixel_format_desc.nVersion = 1;
+    desired_pixel_format_desc.dwFlags = PFD_SUPPORT_OPENGL | PFD_DRAW_TO_WINDOW | PFD_DOUBLEBUFFER;
+    desired_pixel_format_desc.iPixelType = PFD_TYPE_RGBA;
+    desired_pixel_format_desc.cColorBits = 32;
+    desired_pixel_format_desc.cAlphaBits = 8;
+    desired_pixel_format_desc.cDepthBits = 32;
+    desired_pixel_format_desc.dwLayerMask = PFD_MAIN_PLANE;
+
+    pixel_format = ChoosePixelFormat(dc, &desired_pixel_format_desc);
+    if (!pixel_format) {
+      printf("ChoosePixelFormat failed\n");
+      return 0;
+    }
+  }
+
+  PIXELFORMATDESCRIPTOR pixel_format_desc;
+  DescribePixelFormat(dc, pixel_format, sizeof(pixel_format_desc), &pixel_format_desc);
+  if (!SetPixelFormat(dc, pixel_format, &pixel_format_desc)) {
+    printf("SetPixelFormat failed\n");
+    return 0;
+  }
+
+  return 1;
+}
+
+static int gl_init(void) {
+  WNDCLASSA wc = {0};
+  wc.style = CS_OWNDC;
+  wc.lpfnWndProc = DefWindowProcA;
+  wc.hInstance = HINST_THISCOMPONENT;
+  wc.lpszClassName = "WGLLoaderClass";
+  if (!RegisterClassA(&wc)) {
+    return 0;
+  }
+
+  HWND window = CreateWindowExA(0, wc.lpszClassName, "WGLLoader", 0, CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT, 0, 0, wc.hInstance, 0);
+  if (!window) {
+    return 0;
+  }
+
+  HDC dc = GetDC(window);
+  set_window_pixel_format(dc);
+  HGLRC glc = wglCreateContext(dc);
+  if (!wglMakeCurrent(dc, glc)) {
+    return 0;
+  }
+
+  HINSTANCE dll = LoadLibraryA("opengl32.dll");
+  if (!dll) {
+    return 0;
+  }
+
+  typedef PROC WINAPI wglGetProcAddressF(LPCSTR lpszProc);
+
+  wglGetProcAddressF* wglGetProcAddress = (wglGetProcAddressF*)GetProcAddress(dll, "wglGetProcAddress");
+  wglChoosePixelFormatARB = (wglChoosePixelFormatARBF *)wglGetProcAddress("wglChoosePixelFormatARB");
+  wglCreateContextAttribsARB = (wglCreateContextAttribsARBF *)wglGetProcAddress("wglCreateContextAttribsARB");
+
+#define GL_F(ret, name, ...) \
+            gl##name = (name##proc *)wglGetProcAddress("gl" #name); \
+            if (!gl##name) { \
+                printf("Function gl" #name " couldn't be loaded from opengl32.dll\n"); \
+                goto end; \
+            }
+        GL_LIST
+#undef GL_F
+end:
+
+    wglMakeCurrent(0, 0);
+    wglDeleteContext(glc);
+    ReleaseDC(window, dc);
+    DestroyWindow(window);
+
+    return 1;
+}
+
+static int window_init_gl(HWND hwnd) {
+  HDC dc = GetDC(hwnd);
+  set_window_pixel_format(dc);
+
+  static int gl_attribs[] =
+  {
+    WGL_CONTEXT_MAJOR_VERSION_ARB, 3,
+    WGL_CONTEXT_MINOR_VERSION_ARB, 2,
+    WGL_CONTEXT_FLAGS_ARB, 0,
+    WGL_CONTEXT_PROFILE_MASK_ARB, WGL_CONTEXT_COMPATIBILITY_PROFILE_BIT_ARB,
+    0,
+  };
+
+  HGLRC glc = 0;
+  if (wglCreateContextAttribsARB) {
+      glc = wglCreateContextAttribsARB(dc, 0, gl_attribs);
+  } else {
+    printf("wglCreateContextAttribsARB not available\n");
+    return 0;
+  }
+
+  if (!glc) {
+    printf("wglCreateContextAttribsARB failed\n");
+    return 0;
+  }
+
+  if (!wglMakeCurrent(dc, glc)) {
+    printf("wglMakeCurrent failed\n");
+    return 0;
+  }
+
+  ReleaseDC(hwnd, dc);
+  return 1;
+}
+
+
+bool platform_init(int *width, int *height) {
+  HINSTANCE lib = LoadLibrary("user32.dll");
+  int (*SetProcessDPIAware)() = (void*) GetProcAddress(lib, "SetProcessDPIAware");
+  SetProcessDPIAware();
+  FreeLibrary(lib);
+
+  const wchar_t * CLASS_NAME = L"LiteClass";
+  WNDCLASSW window_class = { sizeof(WNDCLASSW) };
+  window_class.style = CS_HREDRAW | CS_VREDRAW | CS_DBLCLKS;
+  window_class.lpfnWndProc = window_proc;
+  window_class.cbClsExtra = 0;
+  window_class.cbWndExtra = sizeof(LONG_PTR);
+  window_class.hInstance = HINST_THISCOMPONENT;
+  window_class.hbrBackground = NULL;
+  window_class.lpszMenuName = NULL;
+  window_class.hCursor = LoadCursor(NULL, IDI_APPLICATION);
+  window_class.lpszClassName = CLASS_NAME;
+
+  RegisterClassW(&window_class);
+
+  int screen_width = GetSystemMetrics(SM_CXSCREEN);
+  int screen_height = GetSystemMetrics(SM_CYSCREEN);
+
+  int window_width = ceil(screen_width * 0.8f);
+  int window_height = ceil(screen_height * 0.8f);
+
+  int window_left = (screen_width - window_width) / 2;
+  int window_top = (screen_height - window_height) / 2;
+
+  hwnd = CreateWindowExW(0,
+                         CLASS_NAME,
+                         L"",
+                         WS_OVERLAPPEDWINDOW,
+                         window_left,
+                         window_top,
+                         window_width,
+                         window_height,
+                         NULL,
+                         NULL,
+                         HINST_THISCOMPONENT,
+                         NULL);
+  if (hwnd == NULL)
+    return false;
+
+  ShowWindow(hwnd, SW_SHOWNORMAL);
+  UpdateWindow(hwnd);
+
+  gl_init();
+  window_init_gl(hwnd);
+
+  glEnable(GL_TEXTURE_2D);
+
+  glGenTextures(1, &back_buffer_texture);
+  glBindTexture(GL_TEXTURE_2D, back_buffer_texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  *width = window_width;
+  *height = window_height;
+  return true;
+}
+
+
+void platform_close(void) {
+  glDeleteTextures(1, &back_buffer_texture);
+}
+
+
+const char* platform_get_name(void) {
+  return "windows";
+}
+
+
+double platform_get_scale(void) {
+  HINSTANCE lib = LoadLibrary("user32.dll");
+  int (*GetDpiForWindow)(HWND) = (void*) GetProcAddress(lib, "GetDpiForWindow");
+  float dpi = GetDpiForWindow(hwnd) / 96.0;
+  FreeLibrary(lib);
+
+  return dpi;
+}
+
+
+void platform_poll_events(void) {
+  MSG msg;
+  /* the W versions so WM_CHAR isn't converted to the ANSI code page */
+  while (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE))
+  {
+    if (msg.message == WM_QUIT)
+    {
+      event_t event = { .type = EVENT_QUIT };
+      event_push(event);
+      return;
+    }
+
+    TranslateMessage(&msg);
+    DispatchMessageW(&msg);
+  }
+}
+
+
+bool platform_wait_event(double timeout) {
+  double deadline = platform_get_time() + timeout;
+  for (;;) {
+    platform_poll_events();
+    double now = platform_get_time();
+    if (event_has() || now >= deadline) { break; }
+    /* not every message queues an event, so keep waiting until one does */
+    double ms = ceil((deadline - now) * 1000);
+    DWORD wait = ms < INFINITE ? (DWORD) ms : INFINITE;
+    MsgWaitForMultipleObjectsEx(0, NULL, wait, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+  }
+  return event_has();
+}
+
+
+void platform_present(const RenColor *pixels, int width, int height,
+  const RenRect *rects, int count) {
+  /* keep the texture and only upload what changed, unless resized */
+  glBindTexture(GL_TEXTURE_2D, back_buffer_texture);
+  if (width != texture_width || height != texture_height) {
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, pixels);
+    texture_width = width;
+    texture_height = height;
+  } else if (count > 0) {
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    for (int i = 0; i < count; i++) {
+      RenRect r = rects[i];
+      glTexSubImage2D(GL_TEXTURE_2D, 0, r.x, r.y, r.width, r.height,
+        GL_BGRA, GL_UNSIGNED_BYTE, pixels + r.x + r.y * width);
+    }
+  } else {
+    return;
+  }
+  draw_back_buffer();
+}
+
+
+void platform_set_cursor(int cursor) {
+}
+
+
+void platform_set_window_title(const char *title) {
+  wchar_t * wtitle = to_wstr(title, NULL);
+  SetWindowTextW(hwnd, wtitle);
+  free(wtitle);
+}
+
+
+void platform_set_window_mode(int mode) {
+  if (mode == WIN_NORMAL) ShowWindow(hwnd, SW_RESTORE);
+  if (mode == WIN_MAXIMIZED || mode == WIN_FULLSCREEN) ShowWindow(hwnd, SW_MAXIMIZE);
+}
+
+
+bool platform_window_has_focus(void) {
+  return GetFocus() == hwnd;
+}
+
+
+bool platform_show_confirm_dialog(const char *title, const char *msg) {
+  int id = MessageBox(0, msg, title, MB_YESNO | MB_ICONWARNING);
+  return id == IDYES;
+}
+
+
+char* platform_get_clipboard(void) {
+  return NULL;
+}
+
+
+void platform_set_clipboard(const char *text) {
+}
+
+
+double platform_get_time(void) {
+  LARGE_INTEGER time, frequency;
+  QueryPerformanceCounter(&time);
+  QueryPerformanceFrequency(&frequency);
+  return time.QuadPart / (double)frequency.QuadPart;
+}
+
+
+void platform_sleep(double seconds) {
+  Sleep(seconds * 1000);
+}
+
+#endif
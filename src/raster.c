@@ -0,0 +1,319 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "raster.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+  #define RASTER_X86
+  #include <immintrin.h>
+#endif
+
+
+static inline RenColor blend_pixel(RenColor dst, RenColor src) {
+  int ia = 0xff - src.a;
+  dst.r = ((src.r * src.a) + (dst.r * ia)) >> 8;
+  dst.g = ((src.g * src.a) + (dst.g * ia)) >> 8;
+  dst.b = ((src.b * src.a) + (dst.b * ia)) >> 8;
+  return dst;
+}
+
+
+static inline RenColor blend_pixel2(RenColor dst, RenColor src, RenColor color) {
+  src.a = (src.a * color.a) >> 8;
+  int ia = 0xff - src.a;
+  dst.r = ((src.r * color.r * src.a) >> 16) + ((dst.r * ia) >> 8);
+  dst.g = ((src.g * color.g * src.a) >> 16) + ((dst.g * ia) >> 8);
+  dst.b = ((src.b * color.b * src.a) >> 16) + ((dst.b * ia) >> 8);
+  return dst;
+}
+
+
+static void fill_scalar(RenColor *dst, int n, RenColor color) {
+  while (n--) { *dst++ = color; }
+}
+
+
+static void blend_scalar(RenColor *dst, int n, RenColor color) {
+  for (; n > 0; n--, dst++) { *dst = blend_pixel(*dst, color); }
+}
+
+
+static void blend_image_scalar(RenColor *dst, const RenColor *src, int n, RenColor color) {
+  for (; n > 0; n--, dst++, src++) { *dst = blend_pixel2(*dst, *src, color); }
+}
+
+
+/* same as blend_image() with a white source image whose alpha is `mask`,
+** except that pixels with no coverage are left as they are; blending them at
+** zero alpha would darken them a little, so text would come out differently
+** depending on how its glyphs' coverage was split between calls */
+static void blend_mask_scalar(RenColor *dst, const uint8_t *mask, int n, RenColor color) {
+  for (; n > 0; n--, dst++, mask++) {
+    if (*mask == 0) { continue; }
+    RenColor src = { 0xff, 0xff, 0xff, *mask };
+    *dst = blend_pixel2(*dst, src, color);
+  }
+}
+
+
+#ifdef RASTER_X86
+
+/* the simd kernels widen each channel to 16 bits and do the same integer math
+** as blend_pixel() and blend_pixel2(); no intermediate exceeds 16 bits, and
+** (a * b) >> 16 is done with mulhi, so the results match exactly. The alpha
+** lane is masked back to dst's alpha before packing */
+
+static inline uint32_t color_bits(RenColor c) {
+  uint32_t n;
+  memcpy(&n, &c, sizeof(n));
+  return n;
+}
+
+
+__attribute__((target("sse2")))
+static void fill_sse2(RenColor *dst, int n, RenColor color) {
+  __m128i c = _mm_set1_epi32(color_bits(color));
+  for (; n >= 4; n -= 4, dst += 4) {
+    _mm_storeu_si128((__m128i*) dst, c);
+  }
+  fill_scalar(dst, n, color);
+}
+
+
+__attribute__((target("sse2")))
+static inline __m128i blend4_sse2(__m128i d, __m128i c, __m128i ia) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo = _mm_unpacklo_epi8(d, zero);
+  __m128i hi = _mm_unpackhi_epi8(d, zero);
+  lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(lo, ia), c), 8);
+  hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(hi, ia), c), 8);
+  return _mm_packus_epi16(lo, hi);
+}
+
+
+__attribute__((target("sse2")))
+static void blend_sse2(RenColor *dst, int n, RenColor color) {
+  /* alpha lane: c = 0 and ia = 256 so that (d.a * 256 + 0) >> 8 == d.a */
+  int ia = 0xff - color.a;
+  __m128i c = _mm_setr_epi16(
+    color.b * color.a, color.g * color.a, color.r * color.a, 0,
+    color.b * color.a, color.g * color.a, color.r * color.a, 0);
+  __m128i iav = _mm_setr_epi16(ia, ia, ia, 256, ia, ia, ia, 256);
+  for (; n >= 4; n -= 4, dst += 4) {
+    __m128i d = _mm_loadu_si128((__m128i*) dst);
+    _mm_storeu_si128((__m128i*) dst, blend4_sse2(d, c, iav));
+  }
+  blend_scalar(dst, n, color);
+}
+
+
+__attribute__((target("sse2")))
+static inline __m128i blend_image2_sse2(__m128i d, __m128i s, __m128i col, __m128i rgb) {
+  /* t.rgb = s.rgb * col.rgb, t.a = s.a * col.a; sa = broadcast(t.a >> 8) */
+  __m128i t = _mm_mullo_epi16(s, col);
+  __m128i sa = _mm_srli_epi16(t, 8);
+  sa = _mm_shufflelo_epi16(sa, _MM_SHUFFLE(3, 3, 3, 3));
+  sa = _mm_shufflehi_epi16(sa, _MM_SHUFFLE(3, 3, 3, 3));
+  __m128i ia = _mm_sub_epi16(_mm_set1_epi16(0xff), sa);
+  __m128i res = _mm_add_epi16(
+    _mm_mulhi_epu16(t, sa),
+    _mm_srli_epi16(_mm_mullo_epi16(d, ia), 8));
+  return _mm_or_si128(_mm_and_si128(res, rgb), _mm_andnot_si128(rgb, d));
+}
+
+
+__attribute__((target("sse2")))
+static void blend_image_sse2(RenColor *dst, const RenColor *src, int n, RenColor color) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i col = _mm_setr_epi16(
+    color.b, color.g, color.r, color.a, color.b, color.g, color.r, color.a);
+  __m128i rgb = _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+  for (; n >= 4; n -= 4, dst += 4, src += 4) {
+    __m128i d = _mm_loadu_si128((__m128i*) dst);
+    __m128i s = _mm_loadu_si128((const __m128i*) src);
+    __m128i lo = blend_image2_sse2(
+      _mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), col, rgb);
+    __m128i hi = blend_image2_sse2(
+      _mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), col, rgb);
+    _mm_storeu_si128((__m128i*) dst, _mm_packus_epi16(lo, hi));
+  }
+  blend_image_scalar(dst, src, n, color);
+}
+
+
+__attribute__((target("sse2")))
+static void blend_mask_sse2(RenColor *dst, const uint8_t *mask, int n, RenColor color) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i col = _mm_setr_epi16(
+    color.b, color.g, color.r, color.a, color.b, color.g, color.r, color.a);
+  __m128i rgb = _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+  __m128i white = _mm_set1_epi32(0x00ffffff);
+  __m128i alpha = _mm_set1_epi32(0xff000000);
+  for (; n >= 4; n -= 4, dst += 4, mask += 4) {
+    /* expand 4 coverage bytes to 4 white pixels with that alpha */
+    uint32_t m;
+    memcpy(&m, mask, sizeof(m));
+    if (m == 0) { continue; }
+    __m128i s = _mm_cvtsi32_si128(m);
+    s = _mm_unpacklo_epi8(s, s);
+    s = _mm_unpacklo_epi16(s, s);
+    s = _mm_and_si128(s, alpha);
+    __m128i keep = _mm_cmpeq_epi32(s, zero);
+    s = _mm_or_si128(s, white);
+    __m128i d = _mm_loadu_si128((__m128i*) dst);
+    __m128i lo = blend_image2_sse2(
+      _mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), col, rgb);
+    __m128i hi = blend_image2_sse2(
+      _mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), col, rgb);
+    __m128i r = _mm_packus_epi16(lo, hi);
+    r = _mm_or_si128(_mm_and_si128(keep, d), _mm_andnot_si128(keep, r));
+    _mm_storeu_si128((__m128i*) dst, r);
+  }
+  blend_mask_scalar(dst, mask, n, color);
+}
+
+
+__attribute__((target("avx2")))
+static void fill_avx2(RenColor *dst, int n, RenColor color) {
+  __m256i c = _mm256_set1_epi32(color_bits(color));
+  for (; n >= 8; n -= 8, dst += 8) {
+    _mm256_storeu_si256((__m256i*) dst, c);
+  }
+  fill_sse2(dst, n, color);
+}
+
+
+__attribute__((target("avx2")))
+static inline __m256i blend8_avx2(__m256i d, __m256i c, __m256i ia) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i lo = _mm256_unpacklo_epi8(d, zero);
+  __m256i hi = _mm256_unpackhi_epi8(d, zero);
+  lo = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(lo, ia), c), 8);
+  hi = _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(hi, ia), c), 8);
+  return _mm256_packus_epi16(lo, hi);
+}
+
+
+__attribute__((target("avx2")))
+static void blend_avx2(RenColor *dst, int n, RenColor color) {
+  int ia = 0xff - color.a;
+  int b = color.b * color.a, g = color.g * color.a, r = color.r * color.a;
+  __m256i c = _mm256_setr_epi16(
+    b, g, r, 0, b, g, r, 0, b, g, r, 0, b, g, r, 0);
+  __m256i iav = _mm256_setr_epi16(
+    ia, ia, ia, 256, ia, ia, ia, 256, ia, ia, ia, 256, ia, ia, ia, 256);
+  for (; n >= 8; n -= 8, dst += 8) {
+    __m256i d = _mm256_loadu_si256((__m256i*) dst);
+    _mm256_storeu_si256((__m256i*) dst, blend8_avx2(d, c, iav));
+  }
+  blend_sse2(dst, n, color);
+}
+
+
+__attribute__((target("avx2")))
+static inline __m256i blend_image4_avx2(__m256i d, __m256i s, __m256i col, __m256i rgb) {
+  __m256i t = _mm256_mullo_epi16(s, col);
+  __m256i sa = _mm256_srli_epi16(t, 8);
+  sa = _mm256_shufflelo_epi16(sa, _MM_SHUFFLE(3, 3, 3, 3));
+  sa = _mm256_shufflehi_epi16(sa, _MM_SHUFFLE(3, 3, 3, 3));
+  __m256i ia = _mm256_sub_epi16(_mm256_set1_epi16(0xff), sa);
+  __m256i res = _mm256_add_epi16(
+    _mm256_mulhi_epu16(t, sa),
+    _mm256_srli_epi16(_mm256_mullo_epi16(d, ia), 8));
+  return _mm256_or_si256(_mm256_and_si256(res, rgb), _mm256_andnot_si256(rgb, d));
+}
+
+
+__attribute__((target("avx2")))
+static void blend_image_avx2(RenColor *dst, const RenColor *src, int n, RenColor color) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i col = _mm256_setr_epi16(
+    color.b, color.g, color.r, color.a, color.b, color.g, color.r, color.a,
+    color.b, color.g, color.r, color.a, color.b, color.g, color.r, color.a);
+  __m256i rgb = _mm256_setr_epi16(
+    -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0);
+  for (; n >= 8; n -= 8, dst += 8, src += 8) {
+    __m256i d = _mm256_loadu_si256((__m256i*) dst);
+    __m256i s = _mm256_loadu_si256((const __m256i*) src);
+    __m256i lo = blend_image4_avx2(
+      _mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero), col, rgb);
+    __m256i hi = blend_image4_avx2(
+      _mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero), col, rgb);
+    _mm256_storeu_si256((__m256i*) dst, _mm256_packus_epi16(lo, hi));
+  }
+  blend_image_sse2(dst, src, n, color);
+}
+
+
+__attribute__((target("avx2")))
+static void blend_mask_avx2(RenColor *dst, const uint8_t *mask, int n, RenColor color) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i col = _mm256_setr_epi16(
+    color.b, color.g, color.r, color.a, color.b, color.g, color.r, color.a,
+    color.b, color.g, color.r, color.a, color.b, color.g, color.r, color.a);
+  __m256i rgb = _mm256_setr_epi16(
+    -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0);
+  __m256i white = _mm256_set1_epi32(0x00ffffff);
+  for (; n >= 8; n -= 8, dst += 8, mask += 8) {
+    uint64_t m;
+    memcpy(&m, mask, sizeof(m));
+    if (m == 0) { continue; }
+    __m256i s = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) mask));
+    __m256i keep = _mm256_cmpeq_epi32(s, zero);
+    s = _mm256_or_si256(_mm256_slli_epi32(s, 24), white);
+    __m256i d = _mm256_loadu_si256((__m256i*) dst);
+    __m256i lo = blend_image4_avx2(
+      _mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero), col, rgb);
+    __m256i hi = blend_image4_avx2(
+      _mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero), col, rgb);
+    __m256i r = _mm256_packus_epi16(lo, hi);
+    _mm256_storeu_si256((__m256i*) dst, _mm256_blendv_epi8(r, d, keep));
+  }
+  blend_mask_sse2(dst, mask, n, color);
+}
+
+#endif
+
+
+static const RasterKernels kernels[] = {
+#ifdef RASTER_X86
+  { "avx2",   fill_avx2,   blend_avx2,   blend_image_avx2,   blend_mask_avx2   },
+  { "sse2",   fill_sse2,   blend_sse2,   blend_image_sse2,   blend_mask_sse2   },
+#endif
+  { "scalar", fill_scalar, blend_scalar, blend_image_scalar, blend_mask_scalar },
+  { NULL }
+};
+
+RasterKernels raster = {
+  "scalar", fill_scalar, blend_scalar, blend_image_scalar, blend_mask_scalar
+};
+
+
+static bool cpu_supports(const char *name) {
+#ifdef RASTER_X86
+  __builtin_cpu_init();
+  if (!strcmp(name, "avx2")) { return __builtin_cpu_supports("avx2"); }
+  if (!strcmp(name, "sse2")) { return __builtin_cpu_supports("sse2"); }
+#endif
+  return !strcmp(name, "scalar");
+}
+
+
+const RasterKernels* raster_get_kernels(const char *name) {
+  for (const RasterKernels *k = kernels; k->name; k++) {
+    if (!strcmp(k->name, name)) {
+      return cpu_supports(name) ? k : NULL;
+    }
+  }
+  return NULL;
+}
+
+
+void raster_init(void) {
+  const char *forced = getenv("LITE_RASTER");
+  const RasterKernels *k = forced ? raster_get_kernels(forced) : NULL;
+  for (int i = 0; !k; i++) {
+    k = raster_get_kernels(kernels[i].name);
+  }
+  raster = *k;
+}
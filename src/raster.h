@@ -0,0 +1,25 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include "renderer.h"
+
+/* row kernels used by the software renderer. raster_init() picks the fastest
+** set the cpu supports (avx2, sse2 or scalar); the LITE_RASTER environment
+** variable can be set to one of those names to force a specific set. All sets
+** produce bit-identical output (`./build.sh rastercheck` builds a check of
+** that); the blend kernels leave dst's alpha untouched */
+
+typedef struct {
+  const char *name;
+  void (*fill)(RenColor *dst, int n, RenColor color);
+  void (*blend)(RenColor *dst, int n, RenColor color);
+  void (*blend_image)(RenColor *dst, const RenColor *src, int n, RenColor color);
+  void (*blend_mask)(RenColor *dst, const uint8_t *mask, int n, RenColor color);
+} RasterKernels;
+
+extern RasterKernels raster;
+
+void raster_init(void);
+const RasterKernels* raster_get_kernels(const char *name);
+
+#endif
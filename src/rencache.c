@@ -1,57 +1,228 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
+#include <stdint.h>
+#include <assert.h>
 #include "rencache.h"
+#include "workers.h"
+#include "trace.h"
+#include "capture.h"
+#include "platform/platform.h"
 
 /* a cache over the software renderer -- all drawing operations are stored as
 ** commands when issued. At the end of the frame we write the commands to a grid
 ** of hash values, take the cells that have changed since the previous frame,
-** merge them into dirty rectangles and redraw only those regions */
+** merge them into dirty rectangles and redraw only those regions. When the
+** dirty area is large the screen is split into horizontal bands which are
+** redrawn concurrently by the worker threads; the rects can overlap, but the
+** bands can't. The command buffer grows as needed and keeps its largest size
+** between frames, so a frame with a lot of text never drops a command.
+**
+** The grid is sized to cover the screen. Unless a cell size is set, the
+** smallest of 24, 48, 96... pixels is used that keeps the grid within
+** MAX_CELLS cells, so small changes on small and regular windows only repaint
+** a small area, while the hashing cost on big screens stays bounded.
+**
+** Each command is hashed once per frame, and the hashes are combined into a
+** fingerprint of the whole frame; when it matches the previous frame's the
+** cells are left alone and nothing is redrawn.
+**
+** While the cells are updated, each drawing command is also added to the list
+** of every TILE_SIZE tile it touches, along with the clip rect it was issued
+** under. A dirty rect covering few tiles replays only the commands from those
+** tiles, in their original order; bigger rects walk the whole command list.
+**
+** Dirty rects are built a row of cells at a time: each run of changed cells
+** is merged into a rect ending on the row above (or a run to its left) when
+** that repaints fewer unchanged pixels than RECT_COST, the estimated cost of
+** setting up and replaying one more rect, and becomes a new rect otherwise.
+**
+** A region can be declared as scrolled with rencache_scroll_region(). The
+** last frame's commands are then also hashed as if moved along with it, and
+** a changed cell inside the moved area that matches those has its pixels
+** moved in the back buffer instead of being redrawn. The strip scrolled into
+** view, the cells crossing the region's edges and the cells that really
+** changed are still redrawn.
+**
+** The commands between rencache_begin_layer() and rencache_end_layer() form a
+** layer. Its commands are hashed into the cells and drawn like any others;
+** a layer whose commands and rect are the same as the last frame's is
+** counted as clean. rencache_replay_layer() lets the caller skip issuing a
+** layer's commands when it knows they haven't changed: the layer's commands
+** are copied from the last frame's buffer along with their hashes, which
+** aren't worked out again. Freeing a font forgets the commands recorded so
+** far, as they may use it.
+**
+** Layers don't keep their pixels: copying a clean layer's pixels back from
+** an image of its own, rather than replaying its commands, measured no
+** faster with tile binning and the text run cache, and slower once the
+** copies into the image were counted.
+**
+** While capturing, each frame's commands and scrolled regions are written to
+** the capture file at the start of rencache_end_frame(), in the format given
+** in capture.h, so the frame can be replayed outside the editor */
 
-#define CELLS_X 80
-#define CELLS_Y 50
-#define CELL_SIZE 96
-#define COMMAND_BUF_SIZE (1024 * 512)
+#define CELL_SIZE_MIN 24
+#define MAX_CELLS 4096
+#define COMMAND_BUF_INITIAL (1024 * 512)
+#define BAND_HEIGHT 96
+#define TILE_SIZE 128
+#define RECT_COST (48 * 48)
+#define MAX_SCROLLS 8
+#define PARALLEL_MIN_AREA (256 * 256)
 
-enum { FREE_FONT, SET_CLIP, DRAW_TEXT, DRAW_RECT };
+enum { FREE_FONT, SET_CLIP, DRAW_TEXT, DRAW_RECT, DRAW_TOKENS, LAYER_BEGIN, LAYER_END };
 
+/* a command takes offsetof(Command, text) bytes plus its text, the struct's
+** tail padding isn't part of it. The layer commands keep the layer's index in
+** `tab_width` */
 typedef struct {
   int type, size;
   RenRect rect;
   RenColor color;
+  unsigned hash;
   RenFont *font;
   int tab_width;
+  RenRect clip;
   char text[0];
 } Command;
 
+/* a DRAW_TOKENS command's text is a list of segments, each followed by its
+** `len` bytes of text and a nul */
+typedef struct {
+  RenColor color;
+  int width, len;
+} Segment;
+
 
-static unsigned cells_buf1[CELLS_X * CELLS_Y];
-static unsigned cells_buf2[CELLS_X * CELLS_Y];
-static unsigned *cells_prev = cells_buf1;
-static unsigned *cells = cells_buf2;
-static RenRect rect_buf[CELLS_X * CELLS_Y / 2];
-static char command_buf[COMMAND_BUF_SIZE];
-static int command_buf_idx;
+static int cell_size, cells_x, cells_y;
+static int cell_size_setting;
+static unsigned *cells_prev;
+static unsigned *cells;
+static RenRect *rect_buf;
+static char *command_buf;
+static size_t command_buf_size;
+static size_t command_buf_idx;
+static char *prev_buf;            /* last frame's commands */
+static size_t prev_buf_size;
+static size_t prev_buf_idx;
 static RenRect screen_rect;
 static bool show_debug;
+static bool show_heatmap;
+static unsigned char *heat;
+static RenCacheStats stats;
+static int frame_commands;
+static uint64_t last_fingerprint;
+static bool last_fingerprint_valid;
+
+/* byte offsets into command_buf of the commands touching a tile */
+typedef struct {
+  uint32_t *items;
+  int count, cap;
+} TileList;
+
+static TileList *tiles;
+static int tiles_x, tiles_y;
+static int commands_replayed;
+static int scrolled_area;
+static double blit_time;
+
+typedef struct {
+  RenRect rect;
+  int dy;
+} Scroll;
+
+static Scroll scrolls[MAX_SCROLLS];
+static int scroll_count;
+static unsigned *moved_prev;
+static unsigned *moved;
+static RenRect *blit_buf;
+static int blit_count;
+
+typedef struct {
+  int id;
+  RenRect rect;
+  uint64_t fingerprint;
+  bool clean;                 /* same commands and rect as last frame */
+  bool used;                  /* begun this frame */
+  /* the clip rects at its start and end, and the byte range of its commands
+  ** in the last buffer it was drawn to; only `recorded` if it can be copied
+  ** by rencache_replay_layer() */
+  RenRect clip, end_clip;
+  size_t cmd_start, cmd_end;
+  int cmd_count;
+  bool recorded;
+  bool replayed;              /* copied from the last frame this frame */
+} Layer;
+
+static Layer *layers;
+static int layer_count, layer_cap;
+static int open_layer = -1;
+static RenRect open_layer_rect;
+static RenRect current_clip;
+static size_t font_freed_at;      /* command_buf_idx after the last FREE_FONT */
+static int layers_replayed;
+
+static FILE *capture;
+static RenFont **capture_fonts;   /* by index in the capture, NULL if free */
+static int capture_font_count;
+
+typedef struct {
+  int rect_count;
+  int band_height;
+} RedrawJob;
 
 
 static inline int min(int a, int b) { return a < b ? a : b; }
 static inline int max(int a, int b) { return a > b ? a : b; }
 
-/* 32bit fnv-1a hash */
+/* commands are hashed a 64bit word at a time; cells combine the 32bit
+** command hashes with a single fnv-1a style step */
 #define HASH_INITIAL 2166136261
+#define HASH_SEED 0x9e3779b97f4a7c15
 
-static void hash(unsigned *h, const void *data, int size) {
-  const unsigned char *p = data;
-  while (size--) {
-    *h = (*h ^ *p++) * 16777619;
+static inline uint64_t hash_word(uint64_t h, uint64_t w) {
+  h = (h ^ w) * 0xff51afd7ed558ccd;
+  return h ^ (h >> 32);
+}
+
+
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t size) {
+  const char *p = data;
+  h = hash_word(h, size);
+  for (; size >= 8; size -= 8, p += 8) {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    h = hash_word(h, w);
+  }
+  if (size > 0) {
+    uint64_t w = 0;
+    memcpy(&w, p, size);
+    h = hash_word(h, w);
   }
+  return h;
+}
+
+
+static inline uint64_t pack(int a, int b) {
+  return (uint32_t) a | (uint64_t) (uint32_t) b << 32;
+}
+
+
+static uint64_t hash_rect(uint64_t h, RenRect r) {
+  h = hash_word(h, pack(r.x, r.y));
+  return hash_word(h, pack(r.width, r.height));
+}
+
+
+static inline unsigned fold(uint64_t h) {
+  return h ^ (h >> 32);
 }
 
 
 static inline int cell_idx(int x, int y) {
-  return x + y * CELLS_X;
+  return x + y * cells_x;
 }
 
 
@@ -70,6 +241,26 @@ static RenRect intersect_rects(RenRect a, RenRect b) {
 }
 
 
+/* glyphs can draw a little outside of their advance and line height (icon
+** fonts in particular), so text is treated as covering a few more pixels on
+** every side when deciding which cells it touches and whether it needs
+** redrawing */
+static RenRect ink_rect(RenRect r) {
+  int pad = r.height / 4 + 1, pad_y = r.height / 8 + 1;
+  return (RenRect) { r.x - pad, r.y - pad_y, r.width + pad * 2, r.height + pad_y * 2 };
+}
+
+
+static int rect_area(RenRect r) {
+  return r.width * r.height;
+}
+
+
+static RenRect move_rect(RenRect r, int dy) {
+  return (RenRect) { r.x, r.y + dy, r.width, r.height };
+}
+
+
 static RenRect merge_rects(RenRect a, RenRect b) {
   int x1 = min(a.x, b.x);
   int y1 = min(a.y, b.y);
@@ -79,15 +270,32 @@ static RenRect merge_rects(RenRect a, RenRect b) {
 }
 
 
+static void* check_alloc(void *ptr) {
+  if (!ptr) {
+    fprintf(stderr, "Fatal error: memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  return ptr;
+}
+
+
+static void reserve_commands(size_t size) {
+  size_t n = command_buf_idx + size;
+  if (n > command_buf_size) {
+    size_t new_size = command_buf_size ? command_buf_size : COMMAND_BUF_INITIAL;
+    while (new_size < n) { new_size *= 2; }
+    command_buf = check_alloc(realloc(command_buf, new_size));
+    command_buf_size = new_size;
+  }
+}
+
+
 static Command* push_command(int type, int size) {
+  reserve_commands(size);
   Command *cmd = (Command*) (command_buf + command_buf_idx);
-  int n = command_buf_idx + size;
-  if (n > COMMAND_BUF_SIZE) {
-    fprintf(stderr, "Warning: (" __FILE__ "): exhausted command buffer\n");
-    return NULL;
-  }
-  command_buf_idx = n;
-  memset(cmd, 0, sizeof(Command));
+  command_buf_idx += size;
+  frame_commands++;
+  memset(cmd, 0, offsetof(Command, text));
   cmd->type = type;
   cmd->size = size;
   return cmd;
@@ -109,25 +317,143 @@ void rencache_show_debug(bool enable) {
 }
 
 
+void rencache_show_heatmap(bool enable) {
+  show_heatmap = enable;
+  if (heat) { memset(heat, 0, cells_x * cells_y); }
+  rencache_invalidate();
+}
+
+
+bool rencache_start_capture(const char *filename) {
+  rencache_stop_capture();
+  capture = fopen(filename, "wb");
+  if (!capture) { return false; }
+  fputs(CAPTURE_MAGIC, capture);
+  return true;
+}
+
+
+void rencache_stop_capture(void) {
+  if (!capture) { return; }
+  if (fclose(capture) != 0) {
+    fprintf(stderr, "Warning: (" __FILE__ "): could not finish writing capture\n");
+  }
+  capture = NULL;
+  free(capture_fonts);
+  capture_fonts = NULL;
+  capture_font_count = 0;
+}
+
+
+void rencache_get_stats(RenCacheStats *s) {
+  *s = stats;
+}
+
+
 void rencache_free_font(RenFont *font) {
-  Command *cmd = push_command(FREE_FONT, sizeof(Command));
-  if (cmd) { cmd->font = font; }
+  Command *cmd = push_command(FREE_FONT, offsetof(Command, text));
+  cmd->font = font;
+  font_freed_at = command_buf_idx;
+  for (int i = 0; i < layer_count; i++) { layers[i].recorded = false; }
 }
 
 
 void rencache_set_clip_rect(RenRect rect) {
-  Command *cmd = push_command(SET_CLIP, sizeof(Command));
-  if (cmd) { cmd->rect = intersect_rects(rect, screen_rect); }
+  Command *cmd = push_command(SET_CLIP, offsetof(Command, text));
+  cmd->rect = intersect_rects(rect, screen_rect);
+  current_clip = cmd->rect;
+}
+
+
+void rencache_begin_layer(int id, RenRect rect) {
+  /* the rect is limited to the current clip rect; an id already used this
+  ** frame doesn't start a layer */
+  rencache_end_layer();
+  rect = intersect_rects(rect, current_clip);
+  if (rect.width == 0 || rect.height == 0) { return; }
+  int idx = 0;
+  while (idx < layer_count && layers[idx].id != id) { idx++; }
+  if (idx == layer_count) {
+    if (layer_count == layer_cap) {
+      layer_cap = layer_cap ? layer_cap * 2 : 8;
+      layers = check_alloc(realloc(layers, layer_cap * sizeof(Layer)));
+    }
+    layers[layer_count++] = (Layer) { .id = id };
+  }
+  if (layers[idx].used) { return; }
+  layers[idx].used = true;
+
+  Command *cmd = push_command(LAYER_BEGIN, offsetof(Command, text));
+  cmd->rect = rect;
+  cmd->tab_width = idx;
+  open_layer = idx;
+  open_layer_rect = rect;
+  layers[idx].clip = current_clip;
+  layers[idx].cmd_start = command_buf_idx;
+  layers[idx].cmd_count = frame_commands;
+}
+
+
+void rencache_end_layer(void) {
+  if (open_layer < 0) { return; }
+  Layer *l = &layers[open_layer];
+  l->end_clip = current_clip;
+  l->cmd_end = command_buf_idx;
+  l->cmd_count = frame_commands - l->cmd_count;
+  l->recorded = l->cmd_start >= font_freed_at;
+  Command *cmd = push_command(LAYER_END, offsetof(Command, text));
+  cmd->rect = open_layer_rect;
+  cmd->tab_width = open_layer;
+  open_layer = -1;
+}
+
+
+bool rencache_replay_layer(int id, RenRect rect) {
+  /* only a layer drawn last frame under the same clip rect and with the same
+  ** rect can be copied */
+  rencache_end_layer();
+  rect = intersect_rects(rect, current_clip);
+  int idx = 0;
+  while (idx < layer_count && layers[idx].id != id) { idx++; }
+  if (idx == layer_count) { return false; }
+  Layer *l = &layers[idx];
+  if (l->used || !l->recorded || memcmp(&l->rect, &rect, sizeof(rect))
+    || memcmp(&l->clip, &current_clip, sizeof(rect))) {
+    return false;
+  }
+
+  size_t start = l->cmd_start, size = l->cmd_end - l->cmd_start;
+  int count = l->cmd_count;
+  RenRect end_clip = l->end_clip;
+  rencache_begin_layer(id, rect);
+  reserve_commands(size);
+  memcpy(command_buf + command_buf_idx, prev_buf + start, size);
+  command_buf_idx += size;
+  frame_commands += count;
+  current_clip = end_clip;
+  l->replayed = true;
+  layers_replayed++;
+  rencache_end_layer();
+  return true;
+}
+
+
+void rencache_scroll_region(RenRect rect, int dy) {
+  /* regions can't overlap, later ones are ignored */
+  rect = intersect_rects(rect, screen_rect);
+  if (dy == 0 || abs(dy) >= rect.height || scroll_count == MAX_SCROLLS) { return; }
+  for (int i = 0; i < scroll_count; i++) {
+    if (rect_area(intersect_rects(scrolls[i].rect, rect)) > 0) { return; }
+  }
+  scrolls[scroll_count++] = (Scroll) { rect, dy };
 }
 
 
 void rencache_draw_rect(RenRect rect, RenColor color) {
   if (!rects_overlap(screen_rect, rect)) { return; }
-  Command *cmd = push_command(DRAW_RECT, sizeof(Command));
-  if (cmd) {
-    cmd->rect = rect;
-    cmd->color = color;
-  }
+  Command *cmd = push_command(DRAW_RECT, offsetof(Command, text));
+  cmd->rect = rect;
+  cmd->color = color;
 }
 
 
@@ -138,158 +464,836 @@ int rencache_draw_text(RenFont *font, const char *text, int x, int y, RenColor c
   rect.width = ren_get_font_width(font, text);
   rect.height = ren_get_font_height(font);
 
-  if (rects_overlap(screen_rect, rect)) {
+  if (rects_overlap(screen_rect, ink_rect(rect))) {
     int sz = strlen(text) + 1;
-    Command *cmd = push_command(DRAW_TEXT, sizeof(Command) + sz);
-    if (cmd) {
-      memcpy(cmd->text, text, sz);
-      cmd->color = color;
-      cmd->font = font;
-      cmd->rect = rect;
-      cmd->tab_width = ren_get_font_tab_width(font);
-    }
+    Command *cmd = push_command(DRAW_TEXT, offsetof(Command, text) + sz);
+    memcpy(cmd->text, text, sz);
+    cmd->color = color;
+    cmd->font = font;
+    cmd->rect = rect;
+    cmd->tab_width = ren_get_font_tab_width(font);
   }
 
   return x + rect.width;
 }
 
 
+int rencache_draw_tokens(RenFont *font, const RenToken *tokens, int count, int x, int y) {
+  int size = offsetof(Command, text);
+  for (int i = 0; i < count; i++) {
+    size += sizeof(Segment) + tokens[i].len + 1;
+  }
+
+  Command *cmd = push_command(DRAW_TOKENS, size);
+  cmd->font = font;
+  cmd->rect = (RenRect) { x, y, 0, ren_get_font_height(font) };
+  cmd->tab_width = ren_get_font_tab_width(font);
+  char *p = cmd->text;
+  for (int i = 0; i < count; i++) {
+    Segment seg = { tokens[i].color, 0, tokens[i].len };
+    seg.width = ren_get_font_width(font, tokens[i].text);
+    cmd->rect.width += seg.width;
+    memcpy(p, &seg, sizeof(seg));
+    p += sizeof(seg);
+    memcpy(p, tokens[i].text, seg.len);
+    p[seg.len] = '\0';
+    p += seg.len + 1;
+  }
+
+  /* drop the command again if it's off screen */
+  int width = cmd->rect.width;
+  if (!rects_overlap(screen_rect, ink_rect(cmd->rect))) {
+    command_buf_idx -= size;
+    frame_commands--;
+  }
+  return x + width;
+}
+
+
+void rencache_set_cell_size(int size) {
+  cell_size_setting = size > 0 ? max(size, 8) : 0;
+}
+
+
 void rencache_invalidate(void) {
-  memset(cells_prev, 0xff, sizeof(cells_buf1));
+  last_fingerprint_valid = false;
+  if (!cells_prev) { return; }
+  memset(cells_prev, 0xff, cells_x * cells_y * sizeof(unsigned));
+}
+
+
+static void resize_grid(int w, int h, int size) {
+  cell_size = size;
+  cells_x = w / size + 1;
+  cells_y = h / size + 1;
+  int n = cells_x * cells_y;
+  free(cells);
+  free(cells_prev);
+  free(rect_buf);
+  free(heat);
+  free(moved);
+  free(moved_prev);
+  free(blit_buf);
+  cells = check_alloc(malloc(n * sizeof(unsigned)));
+  cells_prev = check_alloc(malloc(n * sizeof(unsigned)));
+  moved = check_alloc(malloc(n * sizeof(unsigned)));
+  moved_prev = check_alloc(malloc(n * sizeof(unsigned)));
+  blit_buf = check_alloc(malloc(n * sizeof(RenRect)));
+  rect_buf = check_alloc(malloc(n * sizeof(RenRect)));
+  heat = check_alloc(calloc(n, 1));
+  for (int i = 0; i < n; i++) { cells[i] = HASH_INITIAL; }
+
+  for (int i = 0; i < layer_count; i++) { layers[i].recorded = false; }
+
+  for (int i = 0; i < tiles_x * tiles_y; i++) { free(tiles[i].items); }
+  free(tiles);
+  tiles_x = w / TILE_SIZE + 1;
+  tiles_y = h / TILE_SIZE + 1;
+  tiles = check_alloc(calloc(tiles_x * tiles_y, sizeof(TileList)));
 }
 
 
 void rencache_begin_frame(void) {
-  /* reset all cells if the screen width/height has changed */
   int w, h;
   ren_get_size(&w, &h);
-  if (screen_rect.width != w || h != screen_rect.height) {
+  int size = cell_size_setting;
+  if (size == 0) {
+    size = CELL_SIZE_MIN;
+    while ((w / size + 1) * (h / size + 1) > MAX_CELLS) { size *= 2; }
+  }
+  /* reset all cells if the screen width/height or the cell size has changed */
+  if (screen_rect.width != w || h != screen_rect.height || size != cell_size) {
     screen_rect.width = w;
     screen_rect.height = h;
+    resize_grid(w, h, size);
     rencache_invalidate();
   }
+  current_clip = screen_rect;
 }
 
 
-static void update_overlapping_cells(RenRect r, unsigned h) {
-  int x1 = r.x / CELL_SIZE;
-  int y1 = r.y / CELL_SIZE;
-  int x2 = (r.x + r.width) / CELL_SIZE;
-  int y2 = (r.y + r.height) / CELL_SIZE;
+static unsigned command_hash(Command *cmd) {
+  /* unused fields are zero, the padding and `size` are left out */
+  uint32_t color;
+  memcpy(&color, &cmd->color, sizeof(color));
+  uint64_t h = hash_word(HASH_SEED, pack(cmd->type, cmd->tab_width));
+  h = hash_rect(h, cmd->rect);
+  h = hash_word(h, color);
+  h = hash_word(h, (uintptr_t) cmd->font);
+  if (cmd->type == DRAW_TEXT || cmd->type == DRAW_TOKENS) {
+    h = hash_bytes(h, cmd->text, cmd->size - offsetof(Command, text));
+  }
+  return fold(h);
+}
+
+
+static void update_overlapping_cells(unsigned *grid, RenRect r, unsigned h) {
+  int x1 = r.x / cell_size;
+  int y1 = r.y / cell_size;
+  int x2 = (r.x + r.width) / cell_size;
+  int y2 = (r.y + r.height) / cell_size;
 
   for (int y = y1; y <= y2; y++) {
     for (int x = x1; x <= x2; x++) {
       int idx = cell_idx(x, y);
-      hash(&cells[idx], &h, sizeof(h));
+      grid[idx] = (grid[idx] ^ h) * 16777619;
     }
   }
 }
 
 
-static void push_rect(RenRect r, int *count) {
-  /* try to merge with existing rectangle */
-  for (int i = *count - 1; i >= 0; i--) {
-    RenRect *rp = &rect_buf[i];
-    if (rects_overlap(*rp, r)) {
-      *rp = merge_rects(*rp, r);
+static void bin_command(Command *cmd, RenRect r) {
+  uint32_t offset = (char*) cmd - command_buf;
+  int x1 = r.x / TILE_SIZE;
+  int y1 = r.y / TILE_SIZE;
+  int x2 = (r.x + r.width - 1) / TILE_SIZE;
+  int y2 = (r.y + r.height - 1) / TILE_SIZE;
+
+  for (int y = y1; y <= y2; y++) {
+    for (int x = x1; x <= x2; x++) {
+      TileList *t = &tiles[x + y * tiles_x];
+      if (t->count == t->cap) {
+        t->cap = t->cap ? t->cap * 2 : 64;
+        t->items = check_alloc(realloc(t->items, t->cap * sizeof(uint32_t)));
+      }
+      t->items[t->count++] = offset;
+    }
+  }
+}
+
+
+static void update_token_cells(unsigned *grid, Command *cmd, RenRect cr) {
+  /* each segment only touches the cells it overlaps, so editing one token
+  ** doesn't dirty the whole line */
+  char *p = cmd->text, *end = (char*) cmd + cmd->size;
+  RenRect sr = cmd->rect;
+  while (p < end) {
+    Segment seg;
+    memcpy(&seg, p, sizeof(seg));
+    sr.width = seg.width;
+    RenRect r = intersect_rects(ink_rect(sr), cr);
+    if (r.width > 0 && r.height > 0) {
+      uint64_t h = hash_word(HASH_SEED, (uintptr_t) cmd->font);
+      h = hash_word(h, cmd->tab_width);
+      h = hash_rect(h, sr);
+      h = hash_bytes(h, p, sizeof(seg) + seg.len);
+      update_overlapping_cells(grid, r, fold(h));
+    }
+    sr.x += seg.width;
+    p += sizeof(seg) + seg.len + 1;
+  }
+}
+
+
+static void push_run(RenRect run, int open_first, int *count) {
+  /* merge into the rect reaching this row or the one above that wastes the
+  ** fewest unchanged pixels, as long as they cost less than a rect of its
+  ** own would and the merged rect doesn't overlap another one */
+  int best = -1, best_waste = RECT_COST + 1;
+  for (int i = open_first; i < *count; i++) {
+    RenRect r = rect_buf[i];
+    int waste = rect_area(merge_rects(r, run)) - rect_area(r) - rect_area(run)
+      + rect_area(intersect_rects(r, run));
+    waste *= cell_size * cell_size;
+    if (waste < best_waste) {
+      best = i;
+      best_waste = waste;
+    }
+  }
+  if (best >= 0) {
+    RenRect m = merge_rects(rect_buf[best], run);
+    bool overlaps = false;
+    for (int i = 0; i < *count && !overlaps; i++) {
+      overlaps = i != best && rect_area(intersect_rects(rect_buf[i], m)) > 0;
+    }
+    if (!overlaps) {
+      rect_buf[best] = m;
       return;
     }
   }
-  /* couldn't merge with previous rectangle: push */
-  rect_buf[(*count)++] = r;
+  /* on its own, leaving out the cells another rect already covers: rects are
+  ** bounding boxes, so can reach past the runs they took in on this row */
+  for (int i = 0; i < *count; i++) {
+    RenRect r = rect_buf[i];
+    if (rect_area(intersect_rects(r, run)) == 0) { continue; }
+    int end = run.x + run.width;
+    if (run.x < r.x) {
+      push_run((RenRect) { run.x, run.y, r.x - run.x, 1 }, open_first, count);
+    }
+    if (end > r.x + r.width) {
+      push_run((RenRect) { r.x + r.width, run.y, end - r.x - r.width, 1 }, open_first, count);
+    }
+    return;
+  }
+  rect_buf[(*count)++] = run;
 }
 
 
-void rencache_end_frame(void) {
-  /* update cells from commands */
+static void draw_tokens(Command *cmd, RenRect cr) {
+  char *p = cmd->text, *end = (char*) cmd + cmd->size;
+  RenRect r = cmd->rect;
+  while (p < end) {
+    Segment seg;
+    memcpy(&seg, p, sizeof(seg));
+    p += sizeof(seg);
+    r.width = seg.width;
+    if (rects_overlap(ink_rect(r), cr)) {
+      ren_draw_text(cmd->font, p, r.x, r.y, seg.color, cmd->tab_width);
+    }
+    r.x += seg.width;
+    p += seg.len + 1;
+  }
+}
+
+
+static void draw_command(Command *cmd, RenRect cr) {
+  switch (cmd->type) {
+    case DRAW_RECT:
+      if (!rects_overlap(cmd->rect, cr)) { break; }
+      ren_draw_rect(cmd->rect, cmd->color);
+      break;
+    case DRAW_TEXT:
+      if (!rects_overlap(ink_rect(cmd->rect), cr)) { break; }
+      ren_draw_text(cmd->font, cmd->text, cmd->rect.x, cmd->rect.y, cmd->color,
+        cmd->tab_width);
+      break;
+    case DRAW_TOKENS:
+      if (!rects_overlap(ink_rect(cmd->rect), cr)) { break; }
+      draw_tokens(cmd, cr);
+      break;
+  }
+}
+
+
+static void replay_all(RenRect r) {
+  ren_set_clip_rect(r);
+  Command *cmd = NULL;
+  RenRect cr = r;
+  while (next_command(&cmd)) {
+    if (cmd->type == SET_CLIP) {
+      cr = intersect_rects(cmd->rect, r);
+      ren_set_clip_rect(cr);
+    } else {
+      draw_command(cmd, cr);
+    }
+  }
+  __atomic_fetch_add(&commands_replayed, frame_commands, __ATOMIC_RELAXED);
+}
+
+
+static int compare_offsets(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t*) a, y = *(const uint32_t*) b;
+  return x < y ? -1 : x > y;
+}
+
+
+static void redraw_rect(RenRect r) {
+  static _Thread_local uint32_t *offsets;
+  static _Thread_local int offsets_cap;
+
+  int x1 = r.x / TILE_SIZE;
+  int y1 = r.y / TILE_SIZE;
+  int x2 = (r.x + r.width - 1) / TILE_SIZE;
+  int y2 = (r.y + r.height - 1) / TILE_SIZE;
+  if ((x2 - x1 + 1) * (y2 - y1 + 1) * 4 > tiles_x * tiles_y) {
+    replay_all(r);
+    return;
+  }
+
+  /* gather the commands of all tiles the rect touches, then sort them back
+  ** into paint order and drop the ones touching more than one tile */
+  int n = 0;
+  for (int y = y1; y <= y2; y++) {
+    for (int x = x1; x <= x2; x++) {
+      TileList *t = &tiles[x + y * tiles_x];
+      if (n + t->count > offsets_cap) {
+        offsets_cap = (n + t->count) * 2;
+        offsets = check_alloc(realloc(offsets, offsets_cap * sizeof(uint32_t)));
+      }
+      memcpy(offsets + n, t->items, t->count * sizeof(uint32_t));
+      n += t->count;
+    }
+  }
+  if (x1 != x2 || y1 != y2) {
+    qsort(offsets, n, sizeof(uint32_t), compare_offsets);
+  }
+
+  RenRect last_clip = { 0, 0, -1, -1 };
+  int replayed = 0;
+  for (int i = 0; i < n; i++) {
+    if (i > 0 && offsets[i] == offsets[i - 1]) { continue; }
+    Command *cmd = (Command*) (command_buf + offsets[i]);
+    RenRect cr = intersect_rects(cmd->clip, r);
+    if (cr.width == 0 || cr.height == 0) { continue; }
+    if (memcmp(&cr, &last_clip, sizeof(cr))) {
+      ren_set_clip_rect(cr);
+      last_clip = cr;
+    }
+    draw_command(cmd, cr);
+    replayed++;
+  }
+  __atomic_fetch_add(&commands_replayed, replayed, __ATOMIC_RELAXED);
+}
+
+
+static void redraw_band(void *udata, int band) {
+  RedrawJob *job = udata;
+  int t = trace_begin("redraw band");
+  RenRect b = { 0, band * job->band_height, screen_rect.width, job->band_height };
+  for (int i = 0; i < job->rect_count; i++) {
+    RenRect r = intersect_rects(rect_buf[i], b);
+    if (r.width > 0 && r.height > 0) { redraw_rect(r); }
+  }
+  trace_end(t);
+}
+
+
+static void draw_heatmap(void) {
+  /* cells fade out over a few dozen frames unless they keep being redrawn */
+  ren_set_clip_rect(screen_rect);
+  for (int y = 0; y < cells_y; y++) {
+    for (int x = 0; x < cells_x; x++) {
+      int h = heat[cell_idx(x, y)];
+      if (h == 0) { continue; }
+      RenColor color = { .r = 255, .g = 255 - h, .b = 0, .a = h / 2 };
+      ren_draw_rect((RenRect) { x * cell_size, y * cell_size, cell_size, cell_size }, color);
+    }
+  }
+}
+
+
+static void hash_moved_commands(unsigned *grid, char *buf, size_t size, int dy,
+  RenRect b) {
+  /* hashes the commands in `buf` moved down by `dy` into the cells covering
+  ** `b`. Fills and clip rects are hashed clipped to `b`, so a background moved
+  ** along with the text hashes the same as one drawn in place */
+  RenRect cr = screen_rect;
+  for (char *p = buf; p < buf + size; p += ((Command*) p)->size) {
+    Command *cmd = (Command*) p;
+    if (cmd->type == LAYER_BEGIN || cmd->type == LAYER_END) { continue; }
+    if (cmd->type == SET_CLIP) { cr = cmd->rect; }
+    bool text = cmd->type == DRAW_TEXT || cmd->type == DRAW_TOKENS;
+    RenRect c = intersect_rects(move_rect(cr, dy), b);
+    RenRect r = intersect_rects(move_rect(text ? ink_rect(cmd->rect) : cmd->rect, dy), c);
+    if (r.width == 0 || r.height == 0) { continue; }
+    cmd->rect.y += dy;
+    if (cmd->type == DRAW_TOKENS) {
+      update_token_cells(grid, cmd, c);
+    } else if (text) {
+      update_overlapping_cells(grid, r, dy ? command_hash(cmd) : cmd->hash);
+    } else {
+      Command clipped = *cmd;
+      clipped.rect = intersect_rects(cmd->rect, b);
+      update_overlapping_cells(grid, r, command_hash(&clipped));
+    }
+    cmd->rect.y -= dy;
+  }
+}
+
+
+static void blit_run(RenRect r, int dy, int first) {
+  /* rows of cells are blitted in the direction of the scroll, so a run's
+  ** source pixels are never overwritten before they're copied. The rects
+  ** blitted for a region are merged for presenting */
+  double start = platform_get_time();
+  ren_scroll_rect(r, dy);
+  blit_time += platform_get_time() - start;
+  scrolled_area += rect_area(r);
+  for (int i = blit_count - 1; i >= first; i--) {
+    RenRect *b = &blit_buf[i];
+    if (b->x == r.x && b->width == r.width
+        && (b->y + b->height == r.y || r.y + r.height == b->y)) {
+      *b = merge_rects(*b, r);
+      return;
+    }
+  }
+  blit_buf[blit_count++] = r;
+}
+
+
+static void apply_scrolls(void) {
+  /* a changed cell touching a scrolled region is moved along with it if it
+  ** lies inside the moved area and its content matches last frame's commands
+  ** moved along; `cells_prev` is set so it isn't redrawn. Other changed cells
+  ** are redrawn as usual */
+  for (int i = 0; i < scroll_count; i++) {
+    Scroll s = scrolls[i];
+    RenRect b = intersect_rects(s.rect, move_rect(s.rect, s.dy));
+    int first = blit_count;
+
+    for (int j = 0; j < cells_x * cells_y; j++) {
+      moved[j] = moved_prev[j] = HASH_INITIAL;
+    }
+    hash_moved_commands(moved_prev, prev_buf, prev_buf_idx, s.dy, b);
+    hash_moved_commands(moved, command_buf, command_buf_idx, 0, b);
+
+    int x1 = s.rect.x / cell_size;
+    int y1 = s.rect.y / cell_size;
+    int x2 = (s.rect.x + s.rect.width - 1) / cell_size;
+    int y2 = (s.rect.y + s.rect.height - 1) / cell_size;
+    for (int k = 0; k <= y2 - y1; k++) {
+      int y = s.dy > 0 ? y2 - k : y1 + k;
+      int run_start = -1;
+      for (int x = x1; x <= x2 + 1; x++) {
+        bool blit = false;
+        if (x <= x2) {
+          int idx = cell_idx(x, y);
+          RenRect c = { x * cell_size, y * cell_size, cell_size, cell_size };
+          c = intersect_rects(c, screen_rect);
+          blit = cells[idx] != cells_prev[idx] && moved[idx] == moved_prev[idx]
+            && rect_area(intersect_rects(c, b)) == rect_area(c);
+          if (blit) { cells_prev[idx] = cells[idx]; }
+        }
+        if (blit && run_start < 0) {
+          run_start = x;
+        } else if (!blit && run_start >= 0) {
+          RenRect r = { run_start * cell_size, y * cell_size,
+                        (x - run_start) * cell_size, cell_size };
+          blit_run(intersect_rects(r, screen_rect), s.dy, first);
+          run_start = -1;
+        }
+      }
+    }
+  }
+}
+
+
+static int update_cells(int *cells_changed, int *changed_area) {
+  /* update cells from commands and bin the drawing commands into tiles */
+  for (int i = 0; i < tiles_x * tiles_y; i++) { tiles[i].count = 0; }
   Command *cmd = NULL;
   RenRect cr = screen_rect;
   while (next_command(&cmd)) {
+    /* layer commands draw nothing */
+    if (cmd->type == LAYER_BEGIN || cmd->type == LAYER_END) { continue; }
     if (cmd->type == SET_CLIP) { cr = cmd->rect; }
-    RenRect r = intersect_rects(cmd->rect, cr);
+    bool text = cmd->type == DRAW_TEXT || cmd->type == DRAW_TOKENS;
+    RenRect r = intersect_rects(text ? ink_rect(cmd->rect) : cmd->rect, cr);
     if (r.width == 0 || r.height == 0) { continue; }
-    unsigned h = HASH_INITIAL;
-    hash(&h, cmd, cmd->size);
-    update_overlapping_cells(r, h);
+    if (cmd->type != SET_CLIP) {
+      cmd->clip = cr;
+      bin_command(cmd, r);
+    }
+    if (cmd->type == DRAW_TOKENS) {
+      update_token_cells(cells, cmd, cr);
+    } else {
+      update_overlapping_cells(cells, r, cmd->hash);
+    }
   }
+  if (scroll_count > 0) { apply_scrolls(); }
 
-  /* push rects for all cells changed from last frame, reset cells */
-  int rect_count = 0;
-  int max_x = screen_rect.width / CELL_SIZE + 1;
-  int max_y = screen_rect.height / CELL_SIZE + 1;
-  for (int y = 0; y < max_y; y++) {
-    for (int x = 0; x < max_x; x++) {
+  /* build rects from the runs of cells changed from last frame on each row,
+  ** reset cells. Rects not reaching the current row can't grow any more and
+  ** are moved in front of `open_first` */
+  int rect_count = 0, open_first = 0;
+  *cells_changed = 0;
+  *changed_area = 0;
+  for (int y = 0; y < cells_y; y++) {
+    int run_start = -1;
+    for (int x = 0; x < cells_x; x++) {
       /* compare previous and current cell for change */
       int idx = cell_idx(x, y);
-      if (cells[idx] != cells_prev[idx]) {
-        push_rect((RenRect) { x, y, 1, 1 }, &rect_count);
+      bool changed = cells[idx] != cells_prev[idx];
+      if (changed) {
+        RenRect r = { x * cell_size, y * cell_size, cell_size, cell_size };
+        *changed_area += rect_area(intersect_rects(r, screen_rect));
+        (*cells_changed)++;
+        if (run_start < 0) { run_start = x; }
+      } else if (run_start >= 0) {
+        push_run((RenRect) { run_start, y, x - run_start, 1 }, open_first, &rect_count);
+        run_start = -1;
+      }
+      if (show_heatmap) {
+        int h = heat[idx] - (heat[idx] + 15) / 16 + (changed ? 64 : 0);
+        heat[idx] = min(h, 255);
       }
       cells_prev[idx] = HASH_INITIAL;
     }
+    if (run_start >= 0) {
+      push_run((RenRect) { run_start, y, cells_x - run_start, 1 }, open_first, &rect_count);
+    }
+    for (int i = open_first; i < rect_count; i++) {
+      if (rect_buf[i].y + rect_buf[i].height <= y) {
+        RenRect tmp = rect_buf[open_first];
+        rect_buf[open_first++] = rect_buf[i];
+        rect_buf[i] = tmp;
+      }
+    }
+  }
+
+#ifndef NDEBUG
+  for (int i = 0; i < rect_count; i++) {
+    for (int j = i + 1; j < rect_count; j++) {
+      assert(rect_area(intersect_rects(rect_buf[i], rect_buf[j])) == 0);
+    }
   }
+#endif
 
   /* expand rects from cells to pixels */
   for (int i = 0; i < rect_count; i++) {
     RenRect *r = &rect_buf[i];
-    r->x *= CELL_SIZE;
-    r->y *= CELL_SIZE;
-    r->width *= CELL_SIZE;
-    r->height *= CELL_SIZE;
+    r->x *= cell_size;
+    r->y *= cell_size;
+    r->width *= cell_size;
+    r->height *= cell_size;
     *r = intersect_rects(*r, screen_rect);
   }
 
-  /* redraw updated regions */
-  bool has_free_commands = false;
-  for (int i = 0; i < rect_count; i++) {
-    /* draw */
-    RenRect r = rect_buf[i];
-    ren_set_clip_rect(r);
-
-    cmd = NULL;
-    while (next_command(&cmd)) {
-      switch (cmd->type) {
-        case FREE_FONT:
-          has_free_commands = true;
-          break;
-        case SET_CLIP:
-          ren_set_clip_rect(intersect_rects(cmd->rect, r));
-          break;
-        case DRAW_RECT:
-          ren_draw_rect(cmd->rect, cmd->color);
-          break;
-        case DRAW_TEXT:
-          ren_set_font_tab_width(cmd->font, cmd->tab_width);
-          ren_draw_text(cmd->font, cmd->text, cmd->rect.x, cmd->rect.y, cmd->color);
-          break;
+  /* swap cell buffers; the reset `cells_prev` is filled in next frame */
+  unsigned *tmp = cells;
+  cells = cells_prev;
+  cells_prev = tmp;
+  return rect_count;
+}
+
+
+static void update_layer(Layer *l, RenRect rect, uint64_t fingerprint) {
+  l->clean = l->fingerprint == fingerprint && !memcmp(&rect, &l->rect, sizeof(rect));
+  l->fingerprint = fingerprint;
+  l->rect = rect;
+}
+
+
+static void put_int(int n) {
+  int32_t v = n;
+  fwrite(&v, sizeof(v), 1, capture);
+}
+
+
+static void put_rect(RenRect r) {
+  put_int(r.x);
+  put_int(r.y);
+  put_int(r.width);
+  put_int(r.height);
+}
+
+
+static void put_string(const char *text, int len) {
+  put_int(len);
+  fwrite(text, 1, len, capture);
+}
+
+
+static int capture_font(RenFont *font) {
+  /* returns the font's index in the capture, defining the font if it's new */
+  int idx = -1;
+  for (int i = 0; i < capture_font_count; i++) {
+    if (capture_fonts[i] == font) { return i; }
+    if (!capture_fonts[i] && idx < 0) { idx = i; }
+  }
+  if (idx < 0) {
+    idx = capture_font_count++;
+    capture_fonts = check_alloc(realloc(capture_fonts, capture_font_count * sizeof(RenFont*)));
+  }
+  capture_fonts[idx] = font;
+  const char *filename = ren_get_font_filename(font);
+  float size = ren_get_font_size(font);
+  fputc(CAP_FONT, capture);
+  put_int(idx);
+  fwrite(&size, sizeof(size), 1, capture);
+  put_string(filename, strlen(filename));
+  return idx;
+}
+
+
+static void capture_frame(void) {
+  fputc(CAP_FRAME, capture);
+  put_int(screen_rect.width);
+  put_int(screen_rect.height);
+  for (int i = 0; i < scroll_count; i++) {
+    fputc(CAP_SCROLL, capture);
+    put_rect(scrolls[i].rect);
+    put_int(scrolls[i].dy);
+  }
+
+  Command *cmd = NULL;
+  while (next_command(&cmd)) {
+    int font = 0;
+    if (cmd->type == DRAW_TEXT || cmd->type == DRAW_TOKENS) {
+      font = capture_font(cmd->font);
+    }
+    switch (cmd->type) {
+      case FREE_FONT:
+        for (int i = 0; i < capture_font_count; i++) {
+          if (capture_fonts[i] != cmd->font) { continue; }
+          fputc(CAP_FREE_FONT, capture);
+          put_int(i);
+          capture_fonts[i] = NULL;
+        }
+        break;
+      case SET_CLIP:
+        fputc(CAP_CLIP, capture);
+        put_rect(cmd->rect);
+        break;
+      case DRAW_RECT:
+        fputc(CAP_RECT, capture);
+        put_rect(cmd->rect);
+        fwrite(&cmd->color, sizeof(RenColor), 1, capture);
+        break;
+      case DRAW_TEXT:
+        fputc(CAP_TEXT, capture);
+        put_int(font);
+        put_int(cmd->rect.x);
+        put_int(cmd->rect.y);
+        fwrite(&cmd->color, sizeof(RenColor), 1, capture);
+        put_int(cmd->tab_width);
+        put_string(cmd->text, strlen(cmd->text));
+        break;
+      case DRAW_TOKENS: {
+        char *p = cmd->text, *end = (char*) cmd + cmd->size;
+        int count = 0;
+        while (p < end) {
+          Segment seg;
+          memcpy(&seg, p, sizeof(seg));
+          p += sizeof(seg) + seg.len + 1;
+          count++;
+        }
+        fputc(CAP_TOKENS, capture);
+        put_int(font);
+        put_int(cmd->rect.x);
+        put_int(cmd->rect.y);
+        put_int(cmd->tab_width);
+        put_int(count);
+        for (p = cmd->text; p < end; ) {
+          Segment seg;
+          memcpy(&seg, p, sizeof(seg));
+          p += sizeof(seg);
+          fwrite(&seg.color, sizeof(RenColor), 1, capture);
+          put_string(p, seg.len);
+          p += seg.len + 1;
+        }
+        break;
       }
+      case LAYER_BEGIN:
+        fputc(CAP_LAYER, capture);
+        put_int(layers[cmd->tab_width].id);
+        put_rect(cmd->rect);
+        break;
+      case LAYER_END:
+        fputc(CAP_LAYER_END, capture);
+        break;
     }
+  }
+  fputc(CAP_END_FRAME, capture);
+
+  if (ferror(capture)) {
+    fprintf(stderr, "Warning: (" __FILE__ "): could not write capture, stopped capturing\n");
+    rencache_stop_capture();
+  }
+}
+
 
-    if (show_debug) {
+void rencache_end_frame(void) {
+  rencache_end_layer();
+  if (capture) { capture_frame(); }
+
+  double start = platform_get_time();
+  int t = trace_begin("end_frame");
+  int t_step = trace_begin("hash");
+
+  /* hash the commands; if the frame is the same as the last one the cells
+  ** would be too, so they are kept as they are and nothing is redrawn. The
+  ** heatmap has to fade out each frame, so it always goes through the cells.
+  ** The commands of a replayed layer still have their hashes */
+  uint64_t fingerprint = HASH_SEED, layer_fingerprint = 0;
+  Command *cmd = NULL;
+  RenRect cr = screen_rect;
+  bool replayed = false;
+  while (next_command(&cmd)) {
+    if (!replayed || cmd->type == LAYER_END) { cmd->hash = command_hash(cmd); }
+    if (cmd->type == LAYER_BEGIN) { replayed = layers[cmd->tab_width].replayed; }
+    if (cmd->type == LAYER_END) { replayed = false; }
+    fingerprint = hash_word(fingerprint, cmd->hash);
+    if (cmd->type == SET_CLIP) { cr = cmd->rect; }
+    if (cmd->type == LAYER_BEGIN) {
+      layer_fingerprint = hash_rect(HASH_SEED, cr);
+    } else if (cmd->type == LAYER_END) {
+      update_layer(&layers[cmd->tab_width], cmd->rect, layer_fingerprint);
+    } else {
+      layer_fingerprint = hash_word(layer_fingerprint, cmd->hash);
+    }
+  }
+  bool unchanged = last_fingerprint_valid && fingerprint == last_fingerprint
+    && !show_heatmap;
+
+  /* scrolling moves the last frame's pixels, so they all have to be there and
+  ** match its commands, with no overlay drawn over them */
+  if (!last_fingerprint_valid || unchanged || show_heatmap || show_debug) {
+    scroll_count = 0;
+  }
+  last_fingerprint = fingerprint;
+  last_fingerprint_valid = true;
+
+  int rect_count = 0;
+  int cells_changed = 0, changed_area = 0;
+  if (!unchanged) {
+    rect_count = update_cells(&cells_changed, &changed_area);
+  }
+
+  int area = 0;
+  for (int i = 0; i < rect_count; i++) {
+    area += rect_buf[i].width * rect_buf[i].height;
+  }
+  stats.unchanged = unchanged;
+  stats.cell_size = cell_size;
+  stats.cells_changed = cells_changed;
+  stats.rects = rect_count;
+  stats.rect_area = area;
+  stats.wasted_ratio = area > 0 ? (double) (area - changed_area) / area : 0;
+
+  /* the heatmap is drawn over everything, so everything is redrawn */
+  if (show_heatmap) {
+    rect_buf[0] = screen_rect;
+    rect_count = 1;
+    area = screen_rect.width * screen_rect.height;
+  }
+
+  double hashed = platform_get_time();
+  /* moving pixels counts as drawing */
+  stats.hash_time = hashed - start - blit_time;
+  trace_end(t_step);
+  t_step = trace_begin("redraw");
+
+  /* redraw updated regions */
+  RedrawJob job = { rect_count, screen_rect.height };
+  if (area >= PARALLEL_MIN_AREA && workers_get_count() > 1) {
+    job.band_height = BAND_HEIGHT;
+  }
+  int band_count = (screen_rect.height + job.band_height - 1) / job.band_height;
+  workers_run(redraw_band, &job, band_count);
+
+  if (show_debug) {
+    for (int i = 0; i < rect_count; i++) {
+      RenRect r = rect_buf[i];
+      ren_set_clip_rect(r);
       RenColor color = { rand(), rand(), rand(), 50 };
       ren_draw_rect(r, color);
     }
   }
+  if (show_heatmap) { draw_heatmap(); }
+
+  /* layers not drawn this frame are dropped */
+  int layer_total = 0, layers_clean = 0;
+  for (int i = 0; i < layer_count; i++) {
+    Layer *l = &layers[i];
+    if (!l->used) { continue; }
+    layers_clean += l->clean;
+    l->used = false;
+    l->replayed = false;
+    layers[layer_total++] = *l;
+  }
+  layer_count = layer_total;
+
+  double drawn = platform_get_time();
+  stats.draw_time = drawn - hashed + blit_time;
+  blit_time = 0;
+  trace_end(t_step);
 
   /* update dirty rects */
   if (rect_count > 0) {
     ren_update_rects(rect_buf, rect_count);
   }
+  if (blit_count > 0) {
+    ren_update_rects(blit_buf, blit_count);
+  }
 
   /* free fonts */
-  if (has_free_commands) {
-    cmd = NULL;
-    while (next_command(&cmd)) {
-      if (cmd->type == FREE_FONT) {
-        ren_free_font(cmd->font);
-      }
+  cmd = NULL;
+  while (next_command(&cmd)) {
+    if (cmd->type == FREE_FONT) {
+      ren_free_font(cmd->font);
     }
   }
 
+  t_step = trace_begin("present");
   ren_present();
+  stats.present_time = platform_get_time() - drawn;
+  trace_end(t_step);
 
-  /* swap cell buffer and reset */
-  unsigned *tmp = cells;
-  cells = cells_prev;
-  cells_prev = tmp;
+  stats.commands = frame_commands;
+  stats.commands_replayed = commands_replayed;
+  commands_replayed = 0;
+  stats.command_bytes = command_buf_idx;
+  stats.command_capacity = command_buf_size;
+  stats.scrolled_area = scrolled_area;
+  scrolled_area = 0;
+  stats.layers = layer_total;
+  stats.layers_clean = layers_clean;
+  stats.layers_replayed = layers_replayed;
+  layers_replayed = 0;
+  scroll_count = 0;
+  blit_count = 0;
+  frame_commands = 0;
+
+  /* keep this frame's commands for scrolling the next one */
+  char *buf = prev_buf;
+  size_t buf_size = prev_buf_size;
+  prev_buf = command_buf;
+  prev_buf_size = command_buf_size;
+  prev_buf_idx = command_buf_idx;
+  command_buf = buf;
+  command_buf_size = buf_size;
   command_buf_idx = 0;
+  font_freed_at = 0;
+  trace_end(t);
 }
@@ -4,11 +4,51 @@
 #include <stdbool.h>
 #include "renderer.h"
 
+typedef struct {
+  const char *text;
+  int len;
+  RenColor color;
+} RenToken;
+
+/* values for the last frame; times are in seconds */
+typedef struct {
+  int unchanged;              /* same commands as the frame before */
+  int cell_size;
+  int commands, command_bytes, command_capacity;
+  int commands_replayed;      /* summed over all the rects redrawn */
+  int cells_changed, rects, rect_area;
+  double wasted_ratio;        /* of rect_area, covering unchanged cells */
+  int scrolled_area;          /* moved instead of redrawn */
+  int layers, layers_clean;   /* clean: same commands as the frame before */
+  int layers_replayed;        /* commands copied from the frame before */
+  double hash_time, draw_time, present_time;
+} RenCacheStats;
+
+/* a cell size of 0 picks one from the screen size */
+void rencache_set_cell_size(int size);
 void rencache_show_debug(bool enable);
+void rencache_show_heatmap(bool enable);
+void rencache_get_stats(RenCacheStats *stats);
+/* writes every frame's commands to `filename` until stopped, see capture.h */
+bool rencache_start_capture(const char *filename);
+void rencache_stop_capture(void);
 void rencache_free_font(RenFont *font);
 void rencache_set_clip_rect(RenRect rect);
+/* the region's content moved down by `dy` pixels (up if negative) since the
+** last frame */
+void rencache_scroll_region(RenRect rect, int dy);
+/* the commands up to rencache_end_layer() form a layer covering `rect`
+** (limited to the current clip rect). `id` tells apart the layers of a frame;
+** layers don't nest, so beginning one ends the one before */
+void rencache_begin_layer(int id, RenRect rect);
+void rencache_end_layer(void);
+/* issues the same commands for the layer as the last frame did, if it was
+** drawn under the same clip rect and with the same rect; returns false and
+** does nothing otherwise */
+bool rencache_replay_layer(int id, RenRect rect);
 void rencache_draw_rect(RenRect rect, RenColor color);
 int  rencache_draw_text(RenFont *font, const char *text, int x, int y, RenColor color);
+int  rencache_draw_tokens(RenFont *font, const RenToken *tokens, int count, int x, int y);
 void rencache_invalidate(void);
 void rencache_begin_frame(void);
 void rencache_end_frame(void);
@@ -1,85 +1,130 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <assert.h>
 #include <math.h>
-
-#define WIND32_MEAN_AND_LEAN
-#include <windows.h>
-#include <windowsx.h>
+#include <limits.h>
 
 #include "lib/stb/stb_truetype.h"
+#include "platform/platform.h"
 #include "renderer.h"
-
-#define MAX_GLYPHSET 256
-
-#include <GL/gl.h>
-
-typedef char GLchar;
-typedef ptrdiff_t GLintptr;
-typedef ptrdiff_t GLsizeiptr;
-
-#ifndef HINST_THISCOMPONENT
-IMAGE_DOS_HEADER __ImageBase;
-#define HINST_THISCOMPONENT ((HINSTANCE)&__ImageBase)
-#endif
-
-#define GL_LIST \
-    GL_F(void,      BlendEquation,           GLenum mode) \
-    GL_F(void,      ActiveTexture,           GLenum texture)
-
-typedef BOOL WINAPI wglChoosePixelFormatARBF(HDC hdc, const int *piAttribIList, const FLOAT *pfAttribFList, UINT nMaxFormats, int *piFormats, UINT *nNumFormats);
-typedef HGLRC WINAPI wglCreateContextAttribsARBF(HDC hDC, HGLRC hShareContext, const int *attribList);
-
-wglChoosePixelFormatARBF *wglChoosePixelFormatARB = 0;
-wglCreateContextAttribsARBF *wglCreateContextAttribsARB = 0;
-
-#define WGL_DRAW_TO_WINDOW_ARB                  0x2001
-#define WGL_ACCELERATION_ARB                    0x2003
-#define WGL_FULL_ACCELERATION_ARB               0x2027
-#define WGL_SUPPORT_OPENGL_ARB                  0x2010
-#define WGL_DOUBLE_BUFFER_ARB                   0x2011
-#define WGL_PIXEL_TYPE_ARB                      0x2013
-#define WGL_TYPE_RGBA_ARB                       0x202B
-#define WGL_FRAMEBUFFER_SRGB_CAPABLE_ARB        0x20A9
-#define WGL_CONTEXT_MAJOR_VERSION_ARB           0x2091
-#define WGL_CONTEXT_MINOR_VERSION_ARB           0x2092
-#define WGL_CONTEXT_FLAGS_ARB                   0x2094
-#define WGL_CONTEXT_PROFILE_MASK_ARB            0x9126
-#define WGL_CONTEXT_DEBUG_BIT_ARB               0x0001
-#define WGL_CONTEXT_COMPATIBILITY_PROFILE_BIT_ARB 0x00000002
-#define GL_BGRA 0x80E1
-
-// Common functions.
-#define GL_F(ret, name, ...) typedef ret name##proc(__VA_ARGS__); name##proc * gl##name;
-GL_LIST
-#undef GL_F
-
-
-
+#include "raster.h"
+#include "mapfile.h"
+#include "glyphcache.h"
+#include "workers.h"
+
+#define ATLAS_PAGE_SIZE 256
+#define GLYPH_EMPTY 0xffffffff
+#define TEXT_RUN_SETS 256
+#define TEXT_RUN_WAYS 4
+#define TEXT_RUN_MAX_LEN 128
+#define GLYPH_BLIT_BATCH 128
+#define WIDTH_CACHE_SIZE 256
+#define WIDTH_CACHE_MAX_LEN 32
 
 struct RenImage {
   RenColor *pixels;
   int width, height;
 };
 
+/* glyphs are rasterized one at a time, on first draw, into the font's atlas.
+** The atlas is a list of square 8bit coverage pages, each packed with a
+** skyline allocator. Once the pages reach the glyph cache limit the least
+** recently drawn page is cleared and reused, though never one drawn from this
+** frame; glyph metrics are kept forever, so measuring text never rasterizes */
+
+typedef struct { int x, y, width; } SkylineNode;
+
 typedef struct {
-  RenImage *image;
-  stbtt_bakedchar glyphs[256];
-} GlyphSet;
+  uint8_t *bitmap;
+  int size;
+  SkylineNode *skyline;
+  int skyline_count;
+  unsigned last_used;
+} AtlasPage;
 
-struct RenFont {
+typedef struct {
+  unsigned codepoint;
+  int page;                   /* -1 if not rasterized into the atlas */
+  short x, y, width, height;  /* position on the page */
+  short xoff, yoff;
+  int xadvance;
+  bool cached;                /* coverage is in the disk cache */
+} Glyph;
+
+/* font files are memory mapped and parsed once; every RenFont loaded from the
+** same path shares the face, which is released when its last font is freed */
+typedef struct FontFace {
+  char *filename;
   void *data;
+  size_t data_size;
+  uint64_t hash;              /* of the file, 0 until the disk cache needs it */
   stbtt_fontinfo stbfont;
-  GlyphSet *sets[MAX_GLYPHSET];
-  float size;
-  int height;
+  int refs;
+  struct FontFace *next;
+} FontFace;
+
+/* text is measured far more often than it's drawn. Fonts whose printable
+** ascii glyphs all have the same advance measure ascii text arithmetically;
+** anything else goes through a small direct mapped cache of string widths */
+
+typedef struct {
+  unsigned hash;
+  int len;                    /* -1 if the slot is empty */
+  int tab_width, width;
+  char text[WIDTH_CACHE_MAX_LEN];
+} WidthEntry;
+
+struct RenFont {
+  FontFace *face;
+  unsigned id;                /* in load order, keys the text run cache */
+  float size, scale;
+  int height, ascent;
+  int fixed_advance;          /* 0 if proportional */
+  Glyph *glyphs;
+  int glyph_count, glyph_cap;
+  AtlasPage *pages;
+  int page_count;
+  GlyphCache *disk;
+  WidthEntry *widths;
+  struct RenFont *next;       /* in the list of loaded fonts */
 };
 
-extern HWND hwnd;
+/* runs of text drawn with ren_draw_text() are composited into a coverage
+** strip the first time they're seen, so redrawing the same string (line
+** numbers, tab titles, common tokens) is a single masked blit. The cache is
+** set associative, keyed by font, tab width and text, and bounded by the
+** bytes its strips use. A run whose glyphs' coverage overlaps is drawn a
+** glyph at a time instead, as one blit of the combined coverage wouldn't give
+** the same pixels as blending each glyph in turn */
 
-static struct { int left, top, right, bottom; } clip;
+typedef struct {
+  RenFont *font;
+  char *text;                 /* NULL if the slot is empty */
+  unsigned hash;
+  int tab_width;
+  int x, y, width, height;    /* strip bounds relative to the pen position */
+  int advance;
+  uint8_t *coverage;
+  bool overlaps;              /* not in a strip; drawn a glyph at a time */
+  unsigned last_used;
+} TextRun;
+
+/* each thread drawing into the back buffer has its own clip rect; the glyph
+** tables, atlases and text runs are shared and guarded by font_lock */
+static _Thread_local struct { int left, top, right, bottom; } clip;
+static Mutex font_lock = MUTEX_INIT;
 static RenImage * back_buffer = NULL;
-static int back_buffer_texture = 0;
+static struct { RenRect *rects; int count, cap; } dirty;
+static FontFace *faces;
+static RenFont *fonts;
+static int glyph_cache_limit = 1024 * 1024;
+static unsigned glyph_tick;   /* frame counter for lru eviction */
+static TextRun text_runs[TEXT_RUN_SETS * TEXT_RUN_WAYS];
+static int text_run_cache_limit = 1024 * 1024;
+static int text_run_bytes;
+static RenStats stats;
 
 
 static void* check_alloc(void *ptr) {
@@ -107,403 +152,606 @@ static const char* utf8_to_codepoint(const char *p, unsigned *dst) {
   return p + 1;
 }
 
-static int set_window_pixel_format(HDC dc) {
-  int pixel_format = 0;
-  int extended_pixel_format = 0;
-  if (wglChoosePixelFormatARB) {
-    int attrib[] = {
-      WGL_DRAW_TO_WINDOW_ARB, GL_TRUE,
-      WGL_ACCELERATION_ARB, WGL_FULL_ACCELERATION_ARB,
-      WGL_SUPPORT_OPENGL_ARB, GL_TRUE,
-      WGL_DOUBLE_BUFFER_ARB, GL_TRUE,
-      WGL_PIXEL_TYPE_ARB, WGL_TYPE_RGBA_ARB,
-      WGL_FRAMEBUFFER_SRGB_CAPABLE_ARB, GL_TRUE,
-      0,
-    };
-    wglChoosePixelFormatARB(dc, attrib, 0, 1, &pixel_format, &extended_pixel_format);
-  }
-
-  if (!extended_pixel_format) {
-    PIXELFORMATDESCRIPTOR desired_pixel_format_desc = { 0 };
-
-    desired_pixel_format_desc.nSize = sizeof(PIXELFORMATDESCRIPTOR);
-    desired_pixel_format_desc.nVersion = 1;
-    desired_pixel_format_desc.dwFlags = PFD_SUPPORT_OPENGL | PFD_DRAW_TO_WINDOW | PFD_DOUBLEBUFFER;
-    desired_pixel_format_desc.iPixelType = PFD_TYPE_RGBA;
-    desired_pixel_format_desc.cColorBits = 32;
-    desired_pixel_format_desc.cAlphaBits = 8;
-    desired_pixel_format_desc.cDepthBits = 32;
-    desired_pixel_format_desc.dwLayerMask = PFD_MAIN_PLANE;
-
-    pixel_format = ChoosePixelFormat(dc, &desired_pixel_format_desc);
-    if (!pixel_format) {
-      printf("ChoosePixelFormat failed\n");
-      return 0;
-    }
-  }
+void ren_init(int width, int height) {
+  raster_init();
+  ren_set_clip_rect( (RenRect) { 0, 0, width, height } );
+  back_buffer = ren_new_image(width, height);
+}
 
-  PIXELFORMATDESCRIPTOR pixel_format_desc;
-  DescribePixelFormat(dc, pixel_format, sizeof(pixel_format_desc), &pixel_format_desc);
-  if (!SetPixelFormat(dc, pixel_format, &pixel_format_desc)) {
-    printf("SetPixelFormat failed\n");
-    return 0;
-  }
+void ren_close(void) {
+  ren_free_image(back_buffer);
+}
 
-  return 1;
+void ren_resize(int width, int height) {
+  ren_free_image(back_buffer);
+  back_buffer = ren_new_image(width, height);
 }
 
-static int gl_init(void) {
-  WNDCLASSA wc = {0};
-  wc.style = CS_OWNDC;
-  wc.lpfnWndProc = DefWindowProcA;
-  wc.hInstance = HINST_THISCOMPONENT;
-  wc.lpszClassName = "WGLLoaderClass";
-  if (!RegisterClassA(&wc)) {
-    return 0;
+void ren_update_rects(RenRect *rects, int count) {
+  if (dirty.count + count > dirty.cap) {
+    dirty.cap = dirty.count + count;
+    dirty.rects = check_alloc(realloc(dirty.rects, dirty.cap * sizeof(RenRect)));
   }
+  memcpy(dirty.rects + dirty.count, rects, count * sizeof(RenRect));
+  dirty.count += count;
+}
 
-  HWND window = CreateWindowExA(0, wc.lpszClassName, "WGLLoader", 0, CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT, CW_USEDEFAULT, 0, 0, wc.hInstance, 0);
-  if (!window) {
-    return 0;
-  }
 
-  HDC dc = GetDC(window);
-  set_window_pixel_format(dc);
-  HGLRC glc = wglCreateContext(dc);
-  if (!wglMakeCurrent(dc, glc)) {
-    return 0;
-  }
+void ren_set_clip_rect(RenRect rect) {
+  clip.left   = rect.x;
+  clip.top    = rect.y;
+  clip.right  = rect.x + rect.width;
+  clip.bottom = rect.y + rect.height;
+}
 
-  HINSTANCE dll = LoadLibraryA("opengl32.dll");
-  if (!dll) {
-    return 0;
-  }
 
-  typedef PROC WINAPI wglGetProcAddressF(LPCSTR lpszProc);
+void ren_get_size(int *x, int *y) {
+  *x = back_buffer->width;
+  *y = back_buffer->height;
+}
 
-  wglGetProcAddressF* wglGetProcAddress = (wglGetProcAddressF*)GetProcAddress(dll, "wglGetProcAddress");
-  wglChoosePixelFormatARB = (wglChoosePixelFormatARBF *)wglGetProcAddress("wglChoosePixelFormatARB");
-  wglCreateContextAttribsARB = (wglCreateContextAttribsARBF *)wglGetProcAddress("wglCreateContextAttribsARB");
 
-#define GL_F(ret, name, ...) \
-            gl##name = (name##proc *)wglGetProcAddress("gl" #name); \
-            if (!gl##name) { \
-                printf("Function gl" #name " couldn't be loaded from opengl32.dll\n"); \
-                goto end; \
-            }
-        GL_LIST
-#undef GL_F
-end:
+const RenColor* ren_get_pixels(void) {
+  return back_buffer->pixels;
+}
 
-    wglMakeCurrent(0, 0);
-    wglDeleteContext(glc);
-    ReleaseDC(window, dc);
-    DestroyWindow(window);
+void ren_present(void) {
+  glyph_tick++;
+  platform_present(back_buffer->pixels, back_buffer->width, back_buffer->height,
+    dirty.rects, dirty.count);
+  dirty.count = 0;
+}
 
-    return 1;
+
+RenImage* ren_new_image(int width, int height) {
+  assert(width > 0 && height > 0);
+  RenImage *image = malloc(sizeof(RenImage) + width * height * sizeof(RenColor));
+  check_alloc(image);
+  image->pixels = (void*) (image + 1);
+  image->width = width;
+  image->height = height;
+  return image;
 }
 
-static int window_init_gl(HWND hwnd) {
-  HDC dc = GetDC(hwnd);
-  set_window_pixel_format(dc);
 
-  static int gl_attribs[] =
-  {
-    WGL_CONTEXT_MAJOR_VERSION_ARB, 3,
-    WGL_CONTEXT_MINOR_VERSION_ARB, 2,
-    WGL_CONTEXT_FLAGS_ARB, 0,
-    WGL_CONTEXT_PROFILE_MASK_ARB, WGL_CONTEXT_COMPATIBILITY_PROFILE_BIT_ARB,
-    0,
-  };
+void ren_free_image(RenImage *image) {
+  free(image);
+}
 
-  HGLRC glc = 0;
-  if (wglCreateContextAttribsARB) {
-      glc = wglCreateContextAttribsARB(dc, 0, gl_attribs);
-  } else {
-    printf("wglCreateContextAttribsARB not available\n");
-    return 0;
-  }
 
-  if (!glc) {
-    printf("wglCreateContextAttribsARB failed\n");
-    return 0;
-  }
+void ren_set_glyph_cache_limit(int bytes) {
+  glyph_cache_limit = bytes;
+}
+
+
+static void free_text_run_coverage(TextRun *run) {
+  text_run_bytes -= run->width * run->height;
+  free(run->coverage);
+  run->coverage = NULL;
+  run->width = run->height = 0;
+}
+
+
+static void free_text_run(TextRun *run) {
+  free_text_run_coverage(run);
+  free(run->text);
+  run->text = NULL;
+}
+
 
-  if (!wglMakeCurrent(dc, glc)) {
-    printf("wglMakeCurrent failed\n");
-    return 0;
+static void free_text_runs(RenFont *font) {
+  for (int i = 0; i < TEXT_RUN_SETS * TEXT_RUN_WAYS; i++) {
+    TextRun *run = &text_runs[i];
+    if (run->text && (!font || run->font == font)) { free_text_run(run); }
   }
+}
+
 
-  ReleaseDC(hwnd, dc);
-  return 1;
+void ren_set_text_run_cache_limit(int bytes) {
+  text_run_cache_limit = bytes;
+  free_text_runs(NULL);
 }
 
-void ren_init(int width, int height) {
-  ren_set_clip_rect( (RenRect) { 0, 0, width, height } );
-  back_buffer = ren_new_image(width, height);
 
-  gl_init();
-  window_init_gl(hwnd);
+void ren_get_stats(RenStats *s) {
+  *s = stats;
+}
 
-  glEnable(GL_TEXTURE_2D);
 
-  glGenTextures(1, &back_buffer_texture);
-  glBindTexture(GL_TEXTURE_2D, back_buffer_texture);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+/* pixel counts are updated from all drawing threads */
+static inline void count_pixels(uint64_t *counter, int n) {
+  __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
 }
 
-void ren_close(void) {
-  ren_free_image(back_buffer);
+
+static void reset_page(AtlasPage *page) {
+  page->skyline[0] = (SkylineNode) { 0, 0, page->size };
+  page->skyline_count = 1;
 }
 
-void ren_resize(int width, int height) {
-  window_bitmap.bmiHeader.biWidth = width;
-  window_bitmap.bmiHeader.biHeight = -height;
 
-  ren_free_image(back_buffer);
-  back_buffer = ren_new_image(width, height);
+static void init_page(AtlasPage *page, int size) {
+  page->size = size;
+  page->bitmap = check_alloc(malloc(size * size));
+  /* the nodes are at least a pixel wide, so there are at most `size` of them;
+  ** skyline_insert() adds its node before removing the ones it covers, which
+  ** takes one more */
+  page->skyline = check_alloc(malloc((size + 1) * sizeof(SkylineNode)));
+  page->last_used = glyph_tick;
+  reset_page(page);
 }
 
-void ren_update_rects(RenRect *rects, int count) {
-  /*
-  SDL_UpdateWindowSurfaceRects(window, (SDL_Rect*) rects, count);
-  static bool initial_frame = true;
-  if (initial_frame) {
-    SDL_ShowWindow(window);
-    initial_frame = false;
+
+/* returns the lowest y at which a rect of `width` fits when its left edge is
+** at skyline node `idx`, or -1 if it doesn't fit */
+static int skyline_fit(AtlasPage *page, int idx, int width, int height) {
+  SkylineNode *n = page->skyline;
+  if (n[idx].x + width > page->size) { return -1; }
+  int y = 0;
+  for (int i = idx; width > 0; i++) {
+    if (n[i].y > y) { y = n[i].y; }
+    if (y + height > page->size) { return -1; }
+    width -= n[i].width;
   }
-  */
+  return y;
 }
 
 
-void ren_set_clip_rect(RenRect rect) {
-  clip.left   = rect.x;
-  clip.top    = rect.y;
-  clip.right  = rect.x + rect.width;
-  clip.bottom = rect.y + rect.height;
+static bool skyline_insert(AtlasPage *page, int width, int height, int *x, int *y) {
+  SkylineNode *n = page->skyline;
+  int best = -1, best_y = page->size, best_width = page->size + 1;
+  for (int i = 0; i < page->skyline_count; i++) {
+    int fy = skyline_fit(page, i, width, height);
+    if (fy < 0) { continue; }
+    if (fy < best_y || (fy == best_y && n[i].width < best_width)) {
+      best = i;
+      best_y = fy;
+      best_width = n[i].width;
+    }
+  }
+  if (best < 0) { return false; }
+  *x = n[best].x;
+  *y = best_y;
+
+  /* insert the new node and shrink or remove the nodes it now covers */
+  memmove(&n[best + 1], &n[best], (page->skyline_count - best) * sizeof(*n));
+  n[best] = (SkylineNode) { *x, best_y + height, width };
+  page->skyline_count++;
+  for (int i = best + 1; i < page->skyline_count; i++) {
+    int shrink = n[i - 1].x + n[i - 1].width - n[i].x;
+    if (shrink <= 0) { break; }
+    n[i].x += shrink;
+    n[i].width -= shrink;
+    if (n[i].width > 0) { break; }
+    memmove(&n[i], &n[i + 1], (page->skyline_count - i - 1) * sizeof(*n));
+    page->skyline_count--;
+    i--;
+  }
+
+  /* merge neighbours at the same height */
+  for (int i = 0; i < page->skyline_count - 1; i++) {
+    if (n[i].y == n[i + 1].y) {
+      n[i].width += n[i + 1].width;
+      memmove(&n[i + 1], &n[i + 2], (page->skyline_count - i - 2) * sizeof(*n));
+      page->skyline_count--;
+      i--;
+    }
+  }
+  return true;
 }
 
 
-void ren_get_size(int *x, int *y) {
-  *x = back_buffer->width;
-  *y = back_buffer->height;
+static void evict_page(RenFont *font, int idx, int size) {
+  AtlasPage *page = &font->pages[idx];
+  stats.pages_evicted++;
+  for (int i = 0; i < font->glyph_cap; i++) {
+    if (font->glyphs[i].page == idx) { font->glyphs[i].page = -1; }
+  }
+  if (page->size < size) {
+    free(page->bitmap);
+    free(page->skyline);
+    init_page(page, size);
+  }
+  reset_page(page);
 }
 
-void ren_present(void) {
-  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT);
-
-  glViewport(0, 0, back_buffer->width, back_buffer->height);
 
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-  glOrtho(0.0, back_buffer->width, 0.0, back_buffer->height, 1.0, -1.0);
-  glMatrixMode(GL_MODELVIEW);
-  glLoadIdentity();
+static void rasterize_glyph(RenFont *font, Glyph *g) {
+  int w = g->width, h = g->height;
+  int x, y, idx = -1;
+  for (int i = 0; i < font->page_count && idx < 0; i++) {
+    if (skyline_insert(&font->pages[i], w, h, &x, &y)) { idx = i; }
+  }
 
-  glBindTexture(GL_TEXTURE_2D, back_buffer_texture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, back_buffer->width, back_buffer->height, 0, GL_BGRA, GL_UNSIGNED_BYTE, back_buffer->pixels);
+  if (idx < 0) {
+    int size = ATLAS_PAGE_SIZE;
+    while (size < w || size < h) { size *= 2; }
+    int used = 0;
+    for (int i = 0; i < font->page_count; i++) {
+      used += font->pages[i].size * font->pages[i].size;
+    }
+    /* the least recently used page is reused, unless every page has been
+    ** drawn from this frame: another thread may still be blitting from it */
+    int lru = -1;
+    for (int i = 0; i < font->page_count; i++) {
+      if (font->pages[i].last_used == glyph_tick) { continue; }
+      if (lru < 0 || font->pages[i].last_used < font->pages[lru].last_used) { lru = i; }
+    }
+    if (lru < 0 || used + size * size <= glyph_cache_limit) {
+      /* add a page */
+      font->pages = check_alloc(realloc(font->pages,
+        (font->page_count + 1) * sizeof(AtlasPage)));
+      idx = font->page_count++;
+      init_page(&font->pages[idx], size);
+    } else {
+      idx = lru;
+      evict_page(font, idx, size);
+    }
+    skyline_insert(&font->pages[idx], w, h, &x, &y);
+  }
 
-  glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 1.0f); glVertex2f(0.0f, 0.0f);
-    glTexCoord2f(1.0f, 1.0f); glVertex2f(back_buffer->width, 0.0f);
-    glTexCoord2f(1.0f, 0.0f); glVertex2f(back_buffer->width, back_buffer->height);
-    glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, back_buffer->height);
-  glEnd();
+  AtlasPage *page = &font->pages[idx];
+  uint8_t *dst = page->bitmap + x + y * page->size;
+  GlyphCacheEntry e;
+  const uint8_t *coverage = NULL;
+  if (g->cached) { coverage = glyph_cache_find(font->disk, g->codepoint, &e); }
 
-  HDC dc = GetDC(hwnd);
-  SwapBuffers(dc);
-  ReleaseDC(hwnd, dc);
+  if (coverage) {
+    stats.glyphs_from_disk++;
+    for (int j = 0; j < h; j++) {
+      memcpy(dst + j * page->size, coverage + j * w, w);
+    }
+  } else {
+    stats.glyphs_rasterized++;
+    stbtt_fontinfo *stbfont = &font->face->stbfont;
+    int gi = stbtt_FindGlyphIndex(stbfont, g->codepoint);
+    stbtt_MakeGlyphBitmap(stbfont, dst, w, h, page->size, font->scale, font->scale, gi);
+    if (font->disk && !g->cached) {
+      e = (GlyphCacheEntry) { .codepoint = g->codepoint,
+                              .width = w, .height = h, .xoff = g->xoff,
+                              .yoff = g->yoff, .xadvance = g->xadvance };
+      glyph_cache_add(font->disk, e, dst, page->size);
+      g->cached = true;
+    }
+  }
+  g->page = idx;
+  g->x = x;
+  g->y = y;
 }
 
 
-RenImage* ren_new_image(int width, int height) {
-  assert(width > 0 && height > 0);
-  RenImage *image = malloc(sizeof(RenImage) + width * height * sizeof(RenColor));
-  check_alloc(image);
-  image->pixels = (void*) (image + 1);
-  image->width = width;
-  image->height = height;
-  return image;
+static inline unsigned hash_codepoint(unsigned codepoint, int cap) {
+  return (codepoint * 2654435761u) & (cap - 1);
 }
 
 
-void ren_free_image(RenImage *image) {
-  free(image);
+static Glyph* find_glyph_slot(Glyph *glyphs, int cap, unsigned codepoint) {
+  unsigned i = hash_codepoint(codepoint, cap);
+  while (glyphs[i].codepoint != codepoint && glyphs[i].codepoint != GLYPH_EMPTY) {
+    i = (i + 1) & (cap - 1);
+  }
+  return &glyphs[i];
 }
 
 
-static GlyphSet* load_glyphset(RenFont *font, int idx) {
-  GlyphSet *set = check_alloc(calloc(1, sizeof(GlyphSet)));
+static void grow_glyph_table(RenFont *font) {
+  int cap = font->glyph_cap ? font->glyph_cap * 2 : 256;
+  Glyph *glyphs = check_alloc(malloc(cap * sizeof(Glyph)));
+  for (int i = 0; i < cap; i++) { glyphs[i].codepoint = GLYPH_EMPTY; }
+  for (int i = 0; i < font->glyph_cap; i++) {
+    Glyph *g = &font->glyphs[i];
+    if (g->codepoint != GLYPH_EMPTY) {
+      *find_glyph_slot(glyphs, cap, g->codepoint) = *g;
+    }
+  }
+  free(font->glyphs);
+  font->glyphs = glyphs;
+  font->glyph_cap = cap;
+}
 
-  /* init image */
-  int width = 128;
-  int height = 128;
-retry:
-  set->image = ren_new_image(width, height);
 
-  /* load glyphs */
-  float s =
-    stbtt_ScaleForMappingEmToPixels(&font->stbfont, 1) /
-    stbtt_ScaleForPixelHeight(&font->stbfont, 1);
-  int res = stbtt_BakeFontBitmap(
-    font->data, 0, font->size * s, (void*) set->image->pixels,
-    width, height, idx * 256, 256, set->glyphs);
+static Glyph* get_glyph(RenFont *font, unsigned codepoint) {
+  Glyph *g = find_glyph_slot(font->glyphs, font->glyph_cap, codepoint);
+  if (g->codepoint == codepoint) { return g; }
 
-  /* retry with a larger image buffer if the buffer wasn't large enough */
-  if (res < 0) {
-    width *= 2;
-    height *= 2;
-    ren_free_image(set->image);
-    goto retry;
+  /* not seen before: load metrics only, the bitmap is rasterized on draw */
+  if ((font->glyph_count + 1) * 2 > font->glyph_cap) {
+    grow_glyph_table(font);
+    g = find_glyph_slot(font->glyphs, font->glyph_cap, codepoint);
+  }
+  font->glyph_count++;
+  stats.glyphs_loaded++;
+  g->codepoint = codepoint;
+  g->page = -1;
+  g->x = g->y = 0;
+
+  GlyphCacheEntry e;
+  if (font->disk && glyph_cache_find(font->disk, codepoint, &e)) {
+    g->width = e.width;
+    g->height = e.height;
+    g->xoff = e.xoff;
+    g->yoff = e.yoff;
+    g->xadvance = e.xadvance;
+    g->cached = true;
+    return g;
   }
 
-  /* adjust glyph yoffsets and xadvance */
-  int ascent, descent, linegap;
-  stbtt_GetFontVMetrics(&font->stbfont, &ascent, &descent, &linegap);
-  float scale = stbtt_ScaleForMappingEmToPixels(&font->stbfont, font->size);
-  int scaled_ascent = ascent * scale + 0.5;
-  for (int i = 0; i < 256; i++) {
-    set->glyphs[i].yoff += scaled_ascent;
-    set->glyphs[i].xadvance = floor(set->glyphs[i].xadvance);
+  int advance, lsb, x0, y0, x1, y1;
+  stbtt_fontinfo *stbfont = &font->face->stbfont;
+  int gi = stbtt_FindGlyphIndex(stbfont, codepoint);
+  stbtt_GetGlyphHMetrics(stbfont, gi, &advance, &lsb);
+  stbtt_GetGlyphBitmapBox(stbfont, gi,
+    font->scale, font->scale, &x0, &y0, &x1, &y1);
+
+  g->width = x1 - x0;
+  g->height = y1 - y0;
+  g->xoff = x0;
+  g->yoff = y0 + font->ascent;
+  g->xadvance = floor(font->scale * advance);
+  g->cached = false;
+  return g;
+}
+
+
+static void open_disk_cache(RenFont *font) {
+  FontFace *face = font->face;
+  if (!glyph_cache_enabled()) { return; }
+  if (!face->hash) { face->hash = glyph_cache_hash(face->data, face->data_size); }
+  font->disk = glyph_cache_open(face->hash, font->size, font->scale);
+}
+
+
+void ren_set_glyph_cache_dir(const char *dir) {
+  /* fonts already loaded move to the new directory's cache, taking the glyphs
+  ** they have rasterized so far with them, so the directory can be set after
+  ** the fonts a program starts with are loaded */
+  glyph_cache_set_dir(dir);
+  for (RenFont *font = fonts; font; font = font->next) {
+    if (font->disk) { glyph_cache_close(font->disk); }
+    font->disk = NULL;
+    open_disk_cache(font);
+    for (int i = 0; i < font->glyph_cap; i++) {
+      Glyph *g = &font->glyphs[i];
+      if (g->codepoint == GLYPH_EMPTY) { continue; }
+      g->cached = false;
+      if (!font->disk || g->page < 0) { continue; }
+      AtlasPage *page = &font->pages[g->page];
+      GlyphCacheEntry e = { .codepoint = g->codepoint,
+                            .width = g->width, .height = g->height, .xoff = g->xoff,
+                            .yoff = g->yoff, .xadvance = g->xadvance };
+      glyph_cache_add(font->disk, e, page->bitmap + g->x + g->y * page->size, page->size);
+      g->cached = true;
+    }
   }
+}
+
 
-  /* convert 8bit data to 32bit */
-  for (int i = width * height - 1; i >= 0; i--) {
-    uint8_t n = *((uint8_t*) set->image->pixels + i);
-    set->image->pixels[i] = (RenColor) { .r = 255, .g = 255, .b = 255, .a = n };
+static FontFace* open_face(const char *filename) {
+  for (FontFace *f = faces; f; f = f->next) {
+    if (!strcmp(f->filename, filename)) {
+      f->refs++;
+      return f;
+    }
   }
 
-  return set;
+  size_t size;
+  void *data = map_file(filename, &size);
+  if (!data) { return NULL; }
+
+  FontFace *face = check_alloc(calloc(1, sizeof(FontFace)));
+  if (!stbtt_InitFont(&face->stbfont, data, 0)) {
+    unmap_file(data, size);
+    free(face);
+    return NULL;
+  }
+  face->filename = check_alloc(strdup(filename));
+  face->data = data;
+  face->data_size = size;
+  face->refs = 1;
+  face->next = faces;
+  faces = face;
+  return face;
 }
 
 
-static GlyphSet* get_glyphset(RenFont *font, int codepoint) {
-  int idx = (codepoint >> 8) % MAX_GLYPHSET;
-  if (!font->sets[idx]) {
-    font->sets[idx] = load_glyphset(font, idx);
-  }
-  return font->sets[idx];
+static void close_face(FontFace *face) {
+  if (--face->refs > 0) { return; }
+  FontFace **f = &faces;
+  while (*f != face) { f = &(*f)->next; }
+  *f = face->next;
+  unmap_file(face->data, face->data_size);
+  free(face->filename);
+  free(face);
 }
 
 
 RenFont* ren_load_font(const char *filename, float size) {
-  RenFont *font = NULL;
-  FILE *fp = NULL;
+  FontFace *face = open_face(filename);
+  if (!face) { return NULL; }
 
   /* init font */
-  font = check_alloc(calloc(1, sizeof(RenFont)));
+  static unsigned font_count;
+  RenFont *font = check_alloc(calloc(1, sizeof(RenFont)));
+  font->face = face;
+  font->id = font_count++;
   font->size = size;
-
-  /* load font into buffer */
-  fp = fopen(filename, "rb");
-  if (!fp) { return NULL; }
-  /* get size */
-  fseek(fp, 0, SEEK_END); int buf_size = ftell(fp); fseek(fp, 0, SEEK_SET);
-  /* load */
-  font->data = check_alloc(malloc(buf_size));
-  int _ = fread(font->data, 1, buf_size, fp); (void) _;
-  fclose(fp);
-  fp = NULL;
-
-  /* init stbfont */
-  int ok = stbtt_InitFont(&font->stbfont, font->data, 0);
-  if (!ok) { goto fail; }
+  stbtt_fontinfo *stbfont = &face->stbfont;
 
   /* get height and scale */
   int ascent, descent, linegap;
-  stbtt_GetFontVMetrics(&font->stbfont, &ascent, &descent, &linegap);
-  float scale = stbtt_ScaleForMappingEmToPixels(&font->stbfont, size);
+  stbtt_GetFontVMetrics(stbfont, &ascent, &descent, &linegap);
+  float scale = stbtt_ScaleForMappingEmToPixels(stbfont, size);
   font->height = (ascent - descent + linegap) * scale + 0.5;
+  font->ascent = ascent * scale + 0.5;
+
+  /* rasterization scale, computed the same way stbtt_BakeFontBitmap() does */
+  float s =
+    stbtt_ScaleForMappingEmToPixels(stbfont, 1) /
+    stbtt_ScaleForPixelHeight(stbfont, 1);
+  font->scale = stbtt_ScaleForPixelHeight(stbfont, size * s);
+
+  open_disk_cache(font);
+  font->next = fonts;
+  fonts = font;
 
   /* make tab and newline glyphs invisible */
-  stbtt_bakedchar *g = get_glyphset(font, '\n')->glyphs;
-  g['\t'].x1 = g['\t'].x0;
-  g['\n'].x1 = g['\n'].x0;
+  grow_glyph_table(font);
+  get_glyph(font, '\t')->width = 0;
+  get_glyph(font, '\n')->width = 0;
+
+  /* check for a fixed advance */
+  font->fixed_advance = get_glyph(font, ' ')->xadvance;
+  for (int c = '!'; c <= '~' && font->fixed_advance; c++) {
+    if (get_glyph(font, c)->xadvance != font->fixed_advance) { font->fixed_advance = 0; }
+  }
 
   return font;
-
-fail:
-  if (fp) { fclose(fp); }
-  if (font) { free(font->data); }
-  free(font);
-  return NULL;
 }
 
 
 void ren_free_font(RenFont *font) {
-  for (int i = 0; i < MAX_GLYPHSET; i++) {
-    GlyphSet *set = font->sets[i];
-    if (set) {
-      ren_free_image(set->image);
-      free(set);
-    }
+  for (int i = 0; i < font->page_count; i++) {
+    free(font->pages[i].bitmap);
+    free(font->pages[i].skyline);
   }
-
-  free(font->data);
+  free(font->pages);
+  free(font->glyphs);
+  free(font->widths);
+  free_text_runs(font);
+  if (font->disk) { glyph_cache_close(font->disk); }
+  RenFont **f = &fonts;
+  while (*f != font) { f = &(*f)->next; }
+  *f = font->next;
+  close_face(font->face);
   free(font);
 }
 
 
 void ren_set_font_tab_width(RenFont *font, int n) {
-  GlyphSet *set = get_glyphset(font, '\t');
-  set->glyphs['\t'].xadvance = n;
+  mutex_lock(&font_lock);
+  get_glyph(font, '\t')->xadvance = n;
+  mutex_unlock(&font_lock);
 }
 
 
 int ren_get_font_tab_width(RenFont *font) {
-  GlyphSet *set = get_glyphset(font, '\t');
-  return set->glyphs['\t'].xadvance;
+  mutex_lock(&font_lock);
+  int n = get_glyph(font, '\t')->xadvance;
+  mutex_unlock(&font_lock);
+  return n;
 }
 
 
-int ren_get_font_width(RenFont *font, const char *text) {
+const char* ren_get_font_filename(RenFont *font) {
+  return font->face->filename;
+}
+
+
+float ren_get_font_size(RenFont *font) {
+  return font->size;
+}
+
+
+static int measure_text(RenFont *font, const char *text, int tab_width) {
   int x = 0;
   const char *p = text;
   unsigned codepoint;
   while (*p) {
     p = utf8_to_codepoint(p, &codepoint);
-    GlyphSet *set = get_glyphset(font, codepoint);
-    stbtt_bakedchar *g = &set->glyphs[codepoint & 0xff];
-    x += g->xadvance;
+    x += codepoint == '\t' ? tab_width : get_glyph(font, codepoint)->xadvance;
   }
   return x;
 }
 
 
-int ren_get_font_height(RenFont *font) {
-  return font->height;
-}
+static int get_text_width(RenFont *font, const char *text) {
+  int tab_width = get_glyph(font, '\t')->xadvance;
+
+  /* fixed advance: count characters, giving up on anything but ascii */
+  if (font->fixed_advance) {
+    int n = 0, tabs = 0, newlines = 0;
+    const unsigned char *p = (const unsigned char*) text;
+    for (; *p; p++, n++) {
+      if (*p == '\t') {
+        tabs++;
+      } else if (*p == '\n') {
+        newlines++;
+      } else if (*p < ' ' || *p > '~') {
+        break;
+      }
+    }
+    if (!*p) {
+      stats.width_fixed++;
+      return (n - tabs - newlines) * font->fixed_advance + tabs * tab_width
+        + newlines * get_glyph(font, '\n')->xadvance;
+    }
+  }
+
+  int len = strlen(text);
+  if (len > WIDTH_CACHE_MAX_LEN) {
+    stats.width_misses++;
+    return measure_text(font, text, tab_width);
+  }
 
+  if (!font->widths) {
+    font->widths = check_alloc(malloc(WIDTH_CACHE_SIZE * sizeof(WidthEntry)));
+    for (int i = 0; i < WIDTH_CACHE_SIZE; i++) { font->widths[i].len = -1; }
+  }
+  /* fnv-1a */
+  unsigned h = 2166136261u;
+  for (int i = 0; i < len; i++) { h = (h ^ (uint8_t) text[i]) * 16777619; }
+  WidthEntry *e = &font->widths[h % WIDTH_CACHE_SIZE];
+  if (e->len == len && e->hash == h && e->tab_width == tab_width &&
+      !memcmp(e->text, text, len)) {
+    stats.width_hits++;
+    return e->width;
+  }
 
-static inline RenColor blend_pixel(RenColor dst, RenColor src) {
-  int ia = 0xff - src.a;
-  dst.r = ((src.r * src.a) + (dst.r * ia)) >> 8;
-  dst.g = ((src.g * src.a) + (dst.g * ia)) >> 8;
-  dst.b = ((src.b * src.a) + (dst.b * ia)) >> 8;
-  return dst;
+  stats.width_misses++;
+  e->hash = h;
+  e->len = len;
+  e->tab_width = tab_width;
+  e->width = measure_text(font, text, tab_width);
+  memcpy(e->text, text, len);
+  return e->width;
 }
 
 
-static inline RenColor blend_pixel2(RenColor dst, RenColor src, RenColor color) {
-  src.a = (src.a * color.a) >> 8;
-  int ia = 0xff - src.a;
-  dst.r = ((src.r * color.r * src.a) >> 16) + ((dst.r * ia) >> 8);
-  dst.g = ((src.g * color.g * src.a) >> 16) + ((dst.g * ia) >> 8);
-  dst.b = ((src.b * color.b * src.a) >> 16) + ((dst.b * ia) >> 8);
-  return dst;
+int ren_get_font_width(RenFont *font, const char *text) {
+  mutex_lock(&font_lock);
+  int width = get_text_width(font, text);
+  mutex_unlock(&font_lock);
+  return width;
 }
 
 
-#define rect_draw_loop(expr)        \
-  for (int j = y1; j < y2; j++) {   \
-    for (int i = x1; i < x2; i++) { \
-      *d = expr;                    \
-      d++;                          \
-    }                               \
-    d += dr;                        \
+int ren_get_font_col(RenFont *font, const char *text, double x) {
+  /* returns the byte index (from 1) of the character boundary nearest to x */
+  mutex_lock(&font_lock);
+  int tab_width = get_glyph(font, '\t')->xadvance;
+  int offset = 0, last_idx = 1;
+  const char *p = text;
+  unsigned codepoint;
+  while (*p) {
+    int idx = p - text + 1;
+    p = utf8_to_codepoint(p, &codepoint);
+    int w = codepoint == '\t' ? tab_width : get_glyph(font, codepoint)->xadvance;
+    if (offset >= x) {
+      mutex_unlock(&font_lock);
+      return (offset - x > w / 2.0) ? last_idx : idx;
+    }
+    offset += w;
+    last_idx = idx;
   }
+  mutex_unlock(&font_lock);
+  return p - text;
+}
+
+
+int ren_get_font_height(RenFont *font) {
+  return font->height;
+}
+
 
 void ren_draw_rect(RenRect rect, RenColor color) {
   if (color.a == 0) { return; }
@@ -515,66 +763,288 @@ void ren_draw_rect(RenRect rect, RenColor color) {
   x2 = x2 > clip.right  ? clip.right  : x2;
   y2 = y2 > clip.bottom ? clip.bottom : y2;
 
+  if (x2 <= x1 || y2 <= y1) { return; }
+
   RenColor *d = back_buffer->pixels;
   d += x1 + y1 * back_buffer->width;
-  int dr = back_buffer->width - (x2 - x1);
 
-  if (color.a == 0xff) {
-    rect_draw_loop(color);
-  } else {
-    rect_draw_loop(blend_pixel(*d, color));
+  void (*row)(RenColor*, int, RenColor) =
+    color.a == 0xff ? raster.fill : raster.blend;
+  count_pixels(color.a == 0xff ? &stats.pixels_filled : &stats.pixels_blended,
+    (x2 - x1) * (y2 - y1));
+  for (int j = y1; j < y2; j++) {
+    row(d, x2 - x1, color);
+    d += back_buffer->width;
   }
 }
 
 
-void ren_draw_image(RenImage *image, RenRect *sub, int x, int y, RenColor color) {
-  if (color.a == 0) { return; }
+void ren_scroll_rect(RenRect rect, int dy) {
+  /* fills `rect` with the pixels `dy` rows above it (below if negative). The
+  ** rows are copied in an order that lets the two overlap, the clip rect is
+  ** ignored */
+  int w = back_buffer->width, h = back_buffer->height;
+  int x1 = rect.x < 0 ? 0 : rect.x;
+  int y1 = rect.y < 0 ? 0 : rect.y;
+  int x2 = rect.x + rect.width;
+  int y2 = rect.y + rect.height;
+  x2 = x2 > w ? w : x2;
+  y2 = y2 > h ? h : y2;
+  y1 = y1 < dy ? dy : y1;
+  y2 = y2 > h + dy ? h + dy : y2;
+  if (x2 <= x1 || y2 <= y1) { return; }
+
+  RenColor *p = back_buffer->pixels + x1;
+  size_t size = (x2 - x1) * sizeof(RenColor);
+  if (dy > 0) {
+    for (int y = y2 - 1; y >= y1; y--) { memcpy(p + y * w, p + (y - dy) * w, size); }
+  } else {
+    for (int y = y1; y < y2; y++) { memcpy(p + y * w, p + (y - dy) * w, size); }
+  }
+}
 
-  /* clip */
+
+static bool clip_sub_rect(RenRect *sub, int *x, int *y) {
   int n;
-  if ((n = clip.left - x) > 0) { sub->width  -= n; sub->x += n; x += n; }
-  if ((n = clip.top  - y) > 0) { sub->height -= n; sub->y += n; y += n; }
-  if ((n = x + sub->width  - clip.right ) > 0) { sub->width  -= n; }
-  if ((n = y + sub->height - clip.bottom) > 0) { sub->height -= n; }
+  if ((n = clip.left - *x) > 0) { sub->width  -= n; sub->x += n; *x += n; }
+  if ((n = clip.top  - *y) > 0) { sub->height -= n; sub->y += n; *y += n; }
+  if ((n = *x + sub->width  - clip.right ) > 0) { sub->width  -= n; }
+  if ((n = *y + sub->height - clip.bottom) > 0) { sub->height -= n; }
+  return sub->width > 0 && sub->height > 0;
+}
 
-  if (sub->width <= 0 || sub->height <= 0) {
-    return;
-  }
+
+void ren_draw_image(RenImage *image, RenRect *sub, int x, int y, RenColor color) {
+  if (color.a == 0) { return; }
+  if (!clip_sub_rect(sub, &x, &y)) { return; }
 
   /* draw */
   RenColor *s = image->pixels;
   RenColor *d = back_buffer->pixels;
   s += sub->x + sub->y * image->width;
   d += x + y * back_buffer->width;
-  int sr = image->width - sub->width;
-  int dr = back_buffer->width - sub->width;
+  count_pixels(&stats.pixels_blended, sub->width * sub->height);
 
   for (int j = 0; j < sub->height; j++) {
-    for (int i = 0; i < sub->width; i++) {
-      *d = blend_pixel2(*d, *s, color);
-      d++;
-      s++;
-    }
-    d += dr;
-    s += sr;
+    raster.blend_image(d, s, sub->width, color);
+    d += back_buffer->width;
+    s += image->width;
   }
 }
 
 
-int ren_draw_text(RenFont *font, const char *text, int x, int y, RenColor color) {
-  RenRect rect;
+/* where a glyph's coverage is, worked out under font_lock so it can be blitted
+** once the lock is released. Pages drawn from this frame aren't evicted until
+** the next, so the bitmap stays valid */
+typedef struct {
+  const uint8_t *bitmap;
+  int stride;
+  int x, y, width, height;  /* on screen, clipped */
+} GlyphBlit;
+
+
+static bool place_glyph(RenFont *font, Glyph *g, int x, int y, GlyphBlit *b) {
+  RenRect sub = { 0, 0, g->width, g->height };
+  if (!clip_sub_rect(&sub, &x, &y)) { return false; }
+
+  if (g->page < 0) { rasterize_glyph(font, g); }
+  AtlasPage *page = &font->pages[g->page];
+  page->last_used = glyph_tick;
+
+  b->bitmap = page->bitmap + g->x + sub.x + (g->y + sub.y) * page->size;
+  b->stride = page->size;
+  b->x = x;
+  b->y = y;
+  b->width = sub.width;
+  b->height = sub.height;
+  return true;
+}
+
+
+static void blit_glyph(const GlyphBlit *b, RenColor color) {
+  const uint8_t *s = b->bitmap;
+  RenColor *d = back_buffer->pixels + b->x + b->y * back_buffer->width;
+  count_pixels(&stats.pixels_text, b->width * b->height);
+  for (int j = 0; j < b->height; j++) {
+    raster.blend_mask(d, s, b->width, color);
+    d += back_buffer->width;
+    s += b->stride;
+  }
+}
+
+
+static unsigned hash_text_run(RenFont *font, int tab_width, const char *text, int len) {
+  /* fnv-1a */
+  unsigned h = 2166136261u;
+  unsigned k[2] = { font->id, tab_width };
+  const uint8_t *p = (const uint8_t*) k;
+  for (int i = 0; i < (int) sizeof(k); i++) { h = (h ^ p[i]) * 16777619; }
+  for (int i = 0; i < len; i++) { h = (h ^ (uint8_t) text[i]) * 16777619; }
+  return h;
+}
+
+
+static inline int glyph_advance(Glyph *g, int tab_width) {
+  return g->codepoint == '\t' ? tab_width : g->xadvance;
+}
+
+
+static void build_text_run(RenFont *font, TextRun *run, const char *text) {
+  /* find the bounds of the strip */
+  int x = 0, x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
   const char *p = text;
   unsigned codepoint;
   while (*p) {
     p = utf8_to_codepoint(p, &codepoint);
-    GlyphSet *set = get_glyphset(font, codepoint);
-    stbtt_bakedchar *g = &set->glyphs[codepoint & 0xff];
-    rect.x = g->x0;
-    rect.y = g->y0;
-    rect.width = g->x1 - g->x0;
-    rect.height = g->y1 - g->y0;
-    ren_draw_image(set->image, &rect, x + g->xoff, y + g->yoff, color);
-    x += g->xadvance;
+    Glyph *g = get_glyph(font, codepoint);
+    if (g->width > 0 && g->height > 0) {
+      if (x + g->xoff < x0) { x0 = x + g->xoff; }
+      if (g->yoff < y0) { y0 = g->yoff; }
+      if (x + g->xoff + g->width > x1) { x1 = x + g->xoff + g->width; }
+      if (g->yoff + g->height > y1) { y1 = g->yoff + g->height; }
+    }
+    x += glyph_advance(g, run->tab_width);
+  }
+  run->advance = x;
+  run->overlaps = false;
+  if (x1 <= x0) {
+    run->x = run->y = run->width = run->height = 0;
+    run->coverage = NULL;
+    return;
+  }
+  run->x = x0;
+  run->y = y0;
+  run->width = x1 - x0;
+  run->height = y1 - y0;
+  run->coverage = check_alloc(calloc(run->width * run->height, 1));
+  text_run_bytes += run->width * run->height;
+
+  /* copy the glyphs' coverage in, giving up on the strip if any of it
+  ** overlaps */
+  x = 0;
+  p = text;
+  while (*p) {
+    p = utf8_to_codepoint(p, &codepoint);
+    Glyph *g = get_glyph(font, codepoint);
+    if (g->width > 0 && g->height > 0) {
+      if (g->page < 0) { rasterize_glyph(font, g); }
+      AtlasPage *page = &font->pages[g->page];
+      page->last_used = glyph_tick;
+      uint8_t *s = page->bitmap + g->x + g->y * page->size;
+      uint8_t *d = run->coverage + (x + g->xoff - x0) + (g->yoff - y0) * run->width;
+      for (int j = 0; j < g->height; j++) {
+        for (int i = 0; i < g->width; i++) {
+          if (d[i] && s[i]) {
+            free_text_run_coverage(run);
+            run->overlaps = true;
+            return;
+          }
+          d[i] |= s[i];
+        }
+        d += run->width;
+        s += page->size;
+      }
+    }
+    x += glyph_advance(g, run->tab_width);
+  }
+}
+
+
+/* runs used in the current frame are pinned, as other threads may still be
+** blitting them; returns NULL if the run can't be cached */
+static TextRun* get_text_run(RenFont *font, const char *text, int len, int tab_width) {
+  unsigned h = hash_text_run(font, tab_width, text, len);
+  TextRun *set = &text_runs[(h % TEXT_RUN_SETS) * TEXT_RUN_WAYS];
+  TextRun *victim = NULL;
+  for (int i = 0; i < TEXT_RUN_WAYS; i++) {
+    TextRun *run = &set[i];
+    if (run->text && run->hash == h && run->font == font &&
+        run->tab_width == tab_width && !strcmp(run->text, text)) {
+      run->last_used = glyph_tick;
+      stats.text_run_hits++;
+      return run;
+    }
+    if (run->text && run->last_used == glyph_tick) { continue; }
+    if (!victim || !run->text || (victim->text && run->last_used < victim->last_used)) {
+      victim = run;
+    }
+  }
+
+  stats.text_run_misses++;
+  if (!victim) { return NULL; }
+  if (victim->text) { free_text_run(victim); }
+  victim->font = font;
+  victim->text = check_alloc(malloc(len + 1));
+  memcpy(victim->text, text, len + 1);
+  victim->hash = h;
+  victim->tab_width = tab_width;
+  victim->last_used = glyph_tick;
+  build_text_run(font, victim, text);
+
+  /* keep within the limit by dropping the least recently used runs */
+  while (text_run_bytes > text_run_cache_limit) {
+    TextRun *oldest = NULL;
+    for (int i = 0; i < TEXT_RUN_SETS * TEXT_RUN_WAYS; i++) {
+      TextRun *run = &text_runs[i];
+      if (run->text && run->coverage && run->last_used != glyph_tick &&
+          (!oldest || run->last_used < oldest->last_used)) {
+        oldest = run;
+      }
+    }
+    if (!oldest) { break; }
+    free_text_run(oldest);
+  }
+  return victim;
+}
+
+
+int ren_draw_text(RenFont *font, const char *text, int x, int y, RenColor color, int tab_width) {
+  int len = strlen(text);
+  mutex_lock(&font_lock);
+
+  if (color.a != 0 && len <= TEXT_RUN_MAX_LEN && text_run_cache_limit > 0) {
+    TextRun *run = get_text_run(font, text, len, tab_width);
+    if (run && !run->overlaps) {
+      TextRun r = *run;
+      mutex_unlock(&font_lock);
+      if (r.coverage) {
+        RenRect sub = { 0, 0, r.width, r.height };
+        int rx = x + r.x, ry = y + r.y;
+        if (clip_sub_rect(&sub, &rx, &ry)) {
+          uint8_t *s = r.coverage + sub.x + sub.y * r.width;
+          RenColor *d = back_buffer->pixels + rx + ry * back_buffer->width;
+          count_pixels(&stats.pixels_text, sub.width * sub.height);
+          for (int j = 0; j < sub.height; j++) {
+            raster.blend_mask(d, s, sub.width, color);
+            d += back_buffer->width;
+            s += r.width;
+          }
+        }
+      }
+      return x + r.advance;
+    }
+  }
+
+  /* glyphs are placed in batches under the lock and blitted without it, so
+  ** long lines don't hold up the other threads drawing */
+  GlyphBlit blits[GLYPH_BLIT_BATCH];
+  const char *p = text;
+  unsigned codepoint;
+  while (*p) {
+    int count = 0;
+    while (*p && count < GLYPH_BLIT_BATCH) {
+      p = utf8_to_codepoint(p, &codepoint);
+      Glyph *g = get_glyph(font, codepoint);
+      if (color.a != 0 && place_glyph(font, g, x + g->xoff, y + g->yoff, &blits[count])) {
+        count++;
+      }
+      x += glyph_advance(g, tab_width);
+    }
+    if (count == 0) { continue; }
+    mutex_unlock(&font_lock);
+    for (int i = 0; i < count; i++) { blit_glyph(&blits[i], color); }
+    mutex_lock(&font_lock);
   }
+  mutex_unlock(&font_lock);
   return x;
 }
@@ -9,12 +9,21 @@ typedef struct RenFont RenFont;
 typedef struct { uint8_t b, g, r, a; } RenColor;
 typedef struct { int x, y, width, height; } RenRect;
 
+/* running totals since startup */
+typedef struct {
+  uint64_t pixels_filled, pixels_blended, pixels_text;
+  unsigned glyphs_loaded, glyphs_rasterized, glyphs_from_disk, pages_evicted;
+  unsigned text_run_hits, text_run_misses;
+  unsigned width_hits, width_misses, width_fixed;
+} RenStats;
+
 
 void ren_init(int width, int heigth);
 void ren_close(void);
 void ren_update_rects(RenRect *rects, int count);
 void ren_set_clip_rect(RenRect rect);
 void ren_get_size(int *x, int *y);
+const RenColor* ren_get_pixels(void);
 void ren_resize(int width, int height);
 
 void ren_present(void);
@@ -26,14 +35,23 @@ RenFont* ren_load_font(const char *filename, float size);
 void ren_free_font(RenFont *font);
 void ren_set_font_tab_width(RenFont *font, int n);
 int ren_get_font_tab_width(RenFont *font);
+const char* ren_get_font_filename(RenFont *font);
+float ren_get_font_size(RenFont *font);
 int ren_get_font_width(RenFont *font, const char *text);
+int ren_get_font_col(RenFont *font, const char *text, double x);
 int ren_get_font_height(RenFont *font);
+void ren_set_glyph_cache_limit(int bytes);
+/* NULL turns the disk cache of rasterized glyphs off, see glyphcache.h */
+void ren_set_glyph_cache_dir(const char *dir);
+void ren_set_text_run_cache_limit(int bytes);
+void ren_get_stats(RenStats *stats);
 
 void ren_begin_frame(void);
 void ren_end_frame(void);
 
 void ren_draw_rect(RenRect rect, RenColor color);
+void ren_scroll_rect(RenRect rect, int dy);
 void ren_draw_image(RenImage *image, RenRect *sub, int x, int y, RenColor color);
-int ren_draw_text(RenFont *font, const char *text, int x, int y, RenColor color);
+int ren_draw_text(RenFont *font, const char *text, int x, int y, RenColor color, int tab_width);
 
 #endif
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "trace.h"
+#include "platform/platform.h"
+
+#define MAX_DEPTH 64
+
+typedef struct {
+  double start, duration;
+  int thread;
+  char name[TRACE_NAME_MAX];
+} Span;
+
+typedef struct {
+  double start;
+  char name[TRACE_NAME_MAX];
+} OpenSpan;
+
+/* spans deeper than MAX_DEPTH are counted so depths stay balanced, but are
+** never recorded */
+static _Thread_local struct {
+  int id;
+  int depth;
+  OpenSpan open[MAX_DEPTH];
+} thread;
+
+static bool enabled;
+static Span *spans;
+static uint64_t span_count;
+static int thread_count;
+static double base_time;
+
+
+void trace_set_enabled(bool enable) {
+  if (enable && !spans) {
+    spans = malloc(TRACE_CAPACITY * sizeof(Span));
+    if (!spans) {
+      fprintf(stderr, "Warning: (" __FILE__ "): could not allocate trace buffer\n");
+      return;
+    }
+    base_time = platform_get_time();
+  }
+  enabled = enable;
+}
+
+
+bool trace_enabled(void) {
+  return enabled;
+}
+
+
+static void copy_name(char *dst, const char *src) {
+  /* truncate on a utf-8 character boundary */
+  int len = strlen(src);
+  if (len >= TRACE_NAME_MAX) {
+    len = TRACE_NAME_MAX - 1;
+    while (len > 0 && (src[len] & 0xc0) == 0x80) { len--; }
+  }
+  memcpy(dst, src, len);
+  dst[len] = '\0';
+}
+
+
+int trace_begin(const char *name) {
+  int depth = thread.depth;
+  if (!enabled) { return depth; }
+  if (depth < MAX_DEPTH) {
+    OpenSpan *s = &thread.open[depth];
+    copy_name(s->name, name);
+    s->start = platform_get_time();
+  }
+  thread.depth++;
+  return depth;
+}
+
+
+void trace_end(int depth) {
+  if (depth < 0) { depth = 0; }
+  if (thread.depth <= depth) { return; }
+  double now = platform_get_time();
+  if (thread.id == 0) {
+    thread.id = __atomic_add_fetch(&thread_count, 1, __ATOMIC_RELAXED);
+  }
+  while (thread.depth > depth) {
+    thread.depth--;
+    if (thread.depth >= MAX_DEPTH || !enabled) { continue; }
+    OpenSpan *s = &thread.open[thread.depth];
+    uint64_t n = __atomic_fetch_add(&span_count, 1, __ATOMIC_RELAXED);
+    Span *span = &spans[n % TRACE_CAPACITY];
+    span->start = s->start;
+    span->duration = now - s->start;
+    span->thread = thread.id;
+    memcpy(span->name, s->name, TRACE_NAME_MAX);
+  }
+}
+
+
+void trace_clear(void) {
+  span_count = 0;
+}
+
+
+static void write_string(FILE *fp, const char *s) {
+  fputc('"', fp);
+  for (; *s; s++) {
+    unsigned char c = *s;
+    if (c == '"' || c == '\\') {
+      fprintf(fp, "\\%c", c);
+    } else if (c < 0x20) {
+      fprintf(fp, "\\u%04x", c);
+    } else {
+      fputc(c, fp);
+    }
+  }
+  fputc('"', fp);
+}
+
+
+bool trace_write(const char *filename) {
+  FILE *fp = fopen(filename, "wb");
+  if (!fp) { return false; }
+
+  fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  int threads = __atomic_load_n(&thread_count, __ATOMIC_RELAXED);
+  for (int i = 1; i <= threads; i++) {
+    /* the main thread is always the first to close a span */
+    char name[32] = "main";
+    if (i > 1) { sprintf(name, "worker %d", i - 1); }
+    fprintf(fp, "{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\","
+      "\"args\":{\"name\":\"%s\"}},\n", i, name);
+  }
+
+  uint64_t count = __atomic_load_n(&span_count, __ATOMIC_RELAXED);
+  uint64_t first = count > TRACE_CAPACITY ? count - TRACE_CAPACITY : 0;
+  for (uint64_t n = first; n < count; n++) {
+    Span *s = &spans[n % TRACE_CAPACITY];
+    fprintf(fp, "{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"name\":",
+      s->thread, (s->start - base_time) * 1e6, s->duration * 1e6);
+    write_string(fp, s->name);
+    fprintf(fp, "},\n");
+  }
+  /* ending on the process name keeps the list free of a trailing comma */
+  fprintf(fp, "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"lite\"}}\n");
+  fprintf(fp, "]}\n");
+
+  bool ok = !ferror(fp);
+  return fclose(fp) == 0 && ok;
+}
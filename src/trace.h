@@ -0,0 +1,24 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+
+/* a lightweight span profiler. trace_begin() opens a named span on the calling
+** thread and returns the depth it was opened at; trace_end() closes every span
+** opened at or above that depth, so a span left open by an error is closed by
+** its parent. Closed spans go into a ring buffer holding the most recent
+** TRACE_CAPACITY spans of all threads, which trace_write() saves in the Chrome
+** trace event format (loadable in chrome://tracing or Perfetto). Spans opened
+** while tracing is disabled cost a single check and are not recorded */
+
+#define TRACE_CAPACITY (1 << 16)
+#define TRACE_NAME_MAX 40
+
+void trace_set_enabled(bool enable);
+bool trace_enabled(void);
+int  trace_begin(const char *name);
+void trace_end(int depth);
+void trace_clear(void);
+bool trace_write(const char *filename);
+
+#endif
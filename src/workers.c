@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "workers.h"
+
+#ifdef _WIN32
+  typedef CONDITION_VARIABLE Cond;
+  #define COND_INIT CONDITION_VARIABLE_INIT
+  #define cond_wait(c, m) SleepConditionVariableSRW(c, m, INFINITE, 0)
+  #define cond_broadcast(c) WakeAllConditionVariable(c)
+#else
+  #include <unistd.h>
+  typedef pthread_cond_t Cond;
+  #define COND_INIT PTHREAD_COND_INITIALIZER
+  #define cond_wait(c, m) pthread_cond_wait(c, m)
+  #define cond_broadcast(c) pthread_cond_broadcast(c)
+#endif
+
+#define MAX_THREADS 64
+
+static struct {
+  Mutex lock;
+  Cond start, done;
+  void (*fn)(void*, int);
+  void *udata;
+  int job_count, next_job;
+  int active, busy;
+  unsigned generation;
+  int started;
+} pool = { .lock = MUTEX_INIT, .start = COND_INIT, .done = COND_INIT };
+
+static int thread_count;
+
+
+void mutex_lock(Mutex *m) {
+#ifdef _WIN32
+  AcquireSRWLockExclusive(m);
+#else
+  pthread_mutex_lock(m);
+#endif
+}
+
+
+void mutex_unlock(Mutex *m) {
+#ifdef _WIN32
+  ReleaseSRWLockExclusive(m);
+#else
+  pthread_mutex_unlock(m);
+#endif
+}
+
+
+static void work(void) {
+  int i;
+  while ((i = __atomic_fetch_add(&pool.next_job, 1, __ATOMIC_RELAXED)) < pool.job_count) {
+    pool.fn(pool.udata, i);
+  }
+}
+
+
+static void thread_main(int id) {
+  unsigned seen = 0;
+  mutex_lock(&pool.lock);
+  for (;;) {
+    while (pool.generation == seen) { cond_wait(&pool.start, &pool.lock); }
+    seen = pool.generation;
+    if (id >= pool.active) { continue; }
+    mutex_unlock(&pool.lock);
+    work();
+    mutex_lock(&pool.lock);
+    if (--pool.busy == 0) { cond_broadcast(&pool.done); }
+  }
+}
+
+
+#ifdef _WIN32
+static DWORD WINAPI thread_entry(LPVOID arg) {
+  thread_main((intptr_t) arg);
+  return 0;
+}
+#else
+static void* thread_entry(void *arg) {
+  thread_main((intptr_t) arg);
+  return NULL;
+}
+#endif
+
+
+static bool start_thread(int id) {
+#ifdef _WIN32
+  HANDLE thread = CreateThread(NULL, 0, thread_entry, (LPVOID) (intptr_t) id, 0, NULL);
+  if (!thread) { return false; }
+  CloseHandle(thread);
+  return true;
+#else
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, thread_entry, (void*) (intptr_t) id) != 0) {
+    return false;
+  }
+  pthread_detach(thread);
+  return true;
+#endif
+}
+
+
+static int cpu_count(void) {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors;
+#else
+  return sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+
+void workers_set_count(int n) {
+  thread_count = n < 1 ? 1 : n > MAX_THREADS ? MAX_THREADS : n;
+}
+
+
+int workers_get_count(void) {
+  if (thread_count == 0) {
+    int n = cpu_count();
+    workers_set_count(n > 8 ? 8 : n);
+  }
+  return thread_count;
+}
+
+
+void workers_run(void (*fn)(void *udata, int idx), void *udata, int count) {
+  int helpers = workers_get_count() - 1;
+  if (helpers > count - 1) { helpers = count - 1; }
+
+  /* start any threads we don't have yet; fall back to fewer on failure */
+  while (pool.started < helpers) {
+    if (!start_thread(pool.started)) {
+      fprintf(stderr, "Warning: (" __FILE__ "): could not start worker thread\n");
+      thread_count = pool.started + 1;
+      break;
+    }
+    pool.started++;
+  }
+  if (helpers > pool.started) { helpers = pool.started; }
+
+  if (helpers <= 0) {
+    for (int i = 0; i < count; i++) { fn(udata, i); }
+    return;
+  }
+
+  mutex_lock(&pool.lock);
+  pool.fn = fn;
+  pool.udata = udata;
+  pool.job_count = count;
+  pool.next_job = 0;
+  pool.active = helpers;
+  pool.busy = helpers;
+  pool.generation++;
+  cond_broadcast(&pool.start);
+  mutex_unlock(&pool.lock);
+
+  work();
+
+  mutex_lock(&pool.lock);
+  while (pool.busy > 0) { cond_wait(&pool.done, &pool.lock); }
+  mutex_unlock(&pool.lock);
+}
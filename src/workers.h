@@ -0,0 +1,26 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#ifdef _WIN32
+  #include <windows.h>
+  typedef SRWLOCK Mutex;
+  #define MUTEX_INIT SRWLOCK_INIT
+#else
+  #include <pthread.h>
+  typedef pthread_mutex_t Mutex;
+  #define MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+#endif
+
+/* a small pool of worker threads. workers_run() calls fn(udata, i) for every
+** i in [0, count), spread over the pool and the calling thread, and returns
+** once all calls have finished. With a thread count of 1 everything runs on
+** the calling thread. The default count is the number of cores, up to 8 */
+
+void workers_set_count(int n);
+int workers_get_count(void);
+void workers_run(void (*fn)(void *udata, int idx), void *udata, int count);
+
+void mutex_lock(Mutex *m);
+void mutex_unlock(Mutex *m);
+
+#endif
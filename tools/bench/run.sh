@@ -0,0 +1,35 @@
+#!/bin/bash
+# runs one of the headless scripts in tools/bench/ over a file and prints the
+# averages of the renderer's stats, from a copy of lite set up so it also loads
+# tools/bench/stats.lua; the repo's own data/user is left alone. Build lite
+# first (./build.sh), then e.g.
+#
+#   tools/bench/run.sh scroll src/renderer.c 3840x2160
+#   tools/bench/run.sh idle src/renderer.c 1280x800 96
+#
+# the last argument is the cell size, adaptive when left out
+
+if [[ $# -lt 2 ]]; then
+  echo "usage: $0 <edit|idle|move|scroll|palette> <file> [width x height] [cell size]" >&2
+  exit 1
+fi
+
+repo="$(cd "$(dirname "$0")/../.." && pwd)"
+script="$repo/tools/bench/$1.txt"
+file="$(realpath "$2")"
+tmp="$(mktemp -d)"
+trap 'rm -rf "$tmp"' EXIT
+
+# lite finds its data next to its executable, so it's run from a copy whose
+# user module loads the real one and then the stats hook
+cp "$repo/lite" "$tmp/lite" || exit 1
+mkdir -p "$tmp/data/user"
+for dir in core fonts plugins; do ln -s "$repo/data/$dir" "$tmp/data/$dir"; done
+ln -s "$repo/data/user/colors" "$tmp/data/user/colors"
+cat > "$tmp/data/user/init.lua" <<EOF
+dofile("$repo/data/user/init.lua")
+dofile("$repo/tools/bench/stats.lua")
+EOF
+
+LITE_HEADLESS_SIZE="${3:-1280x800}" LITE_HEADLESS_SCRIPT="$script" \
+  LITE_BENCH_CELL_SIZE="$4" "$tmp/lite" "$file"
@@ -0,0 +1,42 @@
+-- loaded after the user module by tools/bench/run.sh: sets the cell size from
+-- LITE_BENCH_CELL_SIZE if given, captures the frames drawn to the file named by
+-- LITE_BENCH_CAPTURE if given (for tools/replay.c), and prints the averages of
+-- the renderer's stats over the frames it drew to stderr when lite quits
+local core = require "core"
+
+local cell_size = tonumber(os.getenv("LITE_BENCH_CELL_SIZE") or "")
+if cell_size then renderer.set_cell_size(cell_size) end
+
+local capture = os.getenv("LITE_BENCH_CAPTURE")
+if capture and capture ~= "" then assert(renderer.start_capture(capture)) end
+
+local frames, unchanged = 0, 0
+local hash_time, draw_time, rect_area = 0, 0, 0
+local layers_clean, layers_replayed = 0, 0
+
+local end_frame = renderer.end_frame
+renderer.end_frame = function()
+  end_frame()
+  local s = renderer.get_stats()
+  frames = frames + 1
+  unchanged = unchanged + s.unchanged
+  hash_time = hash_time + s.hash_time
+  draw_time = draw_time + s.draw_time
+  rect_area = rect_area + s.rect_area
+  layers_clean = layers_clean + s.layers_clean
+  layers_replayed = layers_replayed + s.layers_replayed
+  cell_size = s.cell_size
+end
+
+local quit = core.quit
+core.quit = function()
+  local n = math.max(frames, 1)
+  io.stderr:write(string.format(
+    "bench: %d frames (%d unchanged), cell size %d, avg hash %.1fus, "
+    .. "draw %.1fus, redrawn %.1fk px, %.1f clean layers, %.1f layers "
+    .. "replayed\n",
+    frames, unchanged, cell_size, hash_time / n * 1e6, draw_time / n * 1e6,
+    rect_area / n / 1000, layers_clean / n, layers_replayed / n))
+  if capture and capture ~= "" then renderer.stop_capture() end
+  quit(true)
+end
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "renderer.h"
+#include "rencache.h"
+
+/* draws a frame whose commands take well over the 512kb the command buffer
+** used to be limited to, and checks none of them were dropped: the command
+** count must match what was issued and the pixels must match drawing the
+** same things straight to the renderer. Run from the repo's root, as it
+** loads data/fonts/monospace.ttf. Exits with a failure status on a mismatch */
+
+#define WIDTH      800
+#define HEIGHT     600
+#define LINES      4000
+#define LINE_LEN   200
+#define MIN_BYTES  (512 * 1024)
+
+static char lines[LINES][LINE_LEN + 1];
+static RenColor bg = { 0x20, 0x20, 0x20, 0xff };
+static RenColor marker = { 0xff, 0x00, 0xff, 0xff };
+static RenRect marker_rect = { WIDTH - 40, HEIGHT - 40, 30, 30 };
+
+
+static RenColor line_color(int i) {
+  RenColor c = { 0x80 + i % 0x80, 0xff - i % 0x80, 0xc0, 0xff };
+  return c;
+}
+
+
+static int line_y(int i) {
+  return (i * 7) % HEIGHT - 10;
+}
+
+
+int main(void) {
+  const char *font_file = "data/fonts/monospace.ttf";
+  ren_init(WIDTH, HEIGHT);
+  RenFont *font = ren_load_font(font_file, 14);
+  if (!font) {
+    fprintf(stderr, "bigframe: could not load '%s', run from the repo's root\n", font_file);
+    return EXIT_FAILURE;
+  }
+  for (int i = 0; i < LINES; i++) {
+    for (int j = 0; j < LINE_LEN; j++) { lines[i][j] = ' ' + (i * 31 + j * 7) % 95; }
+  }
+
+  /* through rencache; the marker is the very last command */
+  RenRect screen = { 0, 0, WIDTH, HEIGHT };
+  rencache_begin_frame();
+  rencache_draw_rect(screen, bg);
+  for (int i = 0; i < LINES; i++) {
+    rencache_draw_text(font, lines[i], 0, line_y(i), line_color(i));
+  }
+  rencache_draw_rect(marker_rect, marker);
+  rencache_end_frame();
+
+  int failed = 0;
+  RenCacheStats s;
+  rencache_get_stats(&s);
+  printf("bigframe: %d commands, %d bytes\n", s.commands, s.command_bytes);
+  fflush(stdout);
+  if (s.command_bytes < MIN_BYTES) {
+    fprintf(stderr, "bigframe: only %d bytes of commands, expected at least %d\n",
+      s.command_bytes, MIN_BYTES);
+    failed = 1;
+  }
+  if (s.commands != LINES + 2) {
+    fprintf(stderr, "bigframe: %d commands, expected %d\n", s.commands, LINES + 2);
+    failed = 1;
+  }
+
+  static RenColor cached[WIDTH * HEIGHT];
+  memcpy(cached, ren_get_pixels(), sizeof(cached));
+
+  /* straight to the renderer */
+  ren_set_clip_rect(screen);
+  ren_draw_rect(screen, bg);
+  for (int i = 0; i < LINES; i++) {
+    ren_draw_text(font, lines[i], 0, line_y(i), line_color(i), ren_get_font_tab_width(font));
+  }
+  ren_draw_rect(marker_rect, marker);
+
+  const RenColor *direct = ren_get_pixels();
+  for (int i = 0; i < WIDTH * HEIGHT; i++) {
+    if (memcmp(&cached[i], &direct[i], sizeof(RenColor))) {
+      fprintf(stderr, "bigframe: pixel %d,%d differs from drawing directly\n",
+        i % WIDTH, i / WIDTH);
+      failed = 1;
+      break;
+    }
+  }
+
+  ren_free_font(font);
+  if (!failed) { printf("bigframe: nothing dropped\n"); }
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
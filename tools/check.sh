@@ -0,0 +1,37 @@
+#!/bin/bash
+# builds and runs the checks in tools/, from the repo's root; exits non-zero if
+# any of them fails
+
+cd "$(dirname "$0")/.."
+failed=0
+
+for tool in rastercheck runcheck bigframe rectcheck; do
+  ./build.sh $tool > /dev/null || exit 1
+  ./lite-$tool || failed=1
+done
+
+./build.sh > /dev/null || exit 1
+LITE_HEADLESS_SIZE=1280x800 LITE_HEADLESS_SCRIPT=tools/blink.txt ./lite src/event.c \
+  || failed=1
+
+# captures of scrolling and editing must replay to the same pixels whatever
+# the text run cache, cell size and thread count
+capture="$(mktemp)"
+LITE_BENCH_CAPTURE="$capture.scroll" tools/bench/run.sh scroll src/renderer.c 1280x800 2> /dev/null
+LITE_BENCH_CAPTURE="$capture.edit" tools/bench/run.sh edit src/renderer.c 1280x800 2> /dev/null
+./build.sh replay > /dev/null || exit 1
+for file in "$capture.scroll" "$capture.edit"; do
+  expected=""
+  for args in "" "-r 0" "-r 4096" "-c 8 -t 4" "-c 1000 -t 1"; do
+    sum="$(./lite-replay -q -f data/fonts $args "$file" | grep -o 'checksum [0-9a-f]*')"
+    [[ -z $expected ]] && expected="$sum"
+    if [[ -z $sum || $sum != "$expected" ]]; then
+      echo "replay: ${file##*.} with '$args' gives ${sum:-no checksum}, not $expected" >&2
+      failed=1
+    fi
+  done
+  [[ $failed == 0 ]] && echo "replay: ${file##*.}: $expected with every cache setting"
+done
+rm -f "$capture" "$capture.scroll" "$capture.edit"
+
+exit $failed
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "raster.h"
+
+/* checks that every simd kernel set the cpu supports gives the same pixels as
+** the scalar kernels: random rows of every width from 0 to MAX_WIDTH, at every
+** alignment within a 32 byte block, with the alpha values where rounding goes
+** wrong first. Pixels either side of the row must be left alone. Exits with a
+** failure status on the first mismatch */
+
+#define MAX_WIDTH 67
+#define GUARD     8
+#define ROUNDS    200
+
+static const uint8_t alphas[] = { 0, 1, 2, 127, 128, 129, 253, 254, 255 };
+static uint32_t seed = 1;
+
+
+static uint8_t rand8(void) {
+  /* xorshift, so the rows are the same on every run */
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed >> 24;
+}
+
+
+static RenColor rand_color(void) {
+  RenColor c = { rand8(), rand8(), rand8(), rand8() };
+  return c;
+}
+
+
+static uint8_t rand_alpha(void) {
+  /* half the time one of the edge cases */
+  if (rand8() & 1) { return alphas[rand8() % sizeof(alphas)]; }
+  return rand8();
+}
+
+
+static const char *kernel_name;
+static const char *fn_name;
+static int failures;
+
+
+static void compare(const RenColor *a, const RenColor *b, int n, int offset, RenColor color) {
+  if (!memcmp(a, b, (n + GUARD * 2) * sizeof(RenColor))) { return; }
+  for (int i = 0; i < n + GUARD * 2; i++) {
+    if (memcmp(&a[i], &b[i], sizeof(RenColor))) {
+      fprintf(stderr, "rastercheck: %s %s differs from scalar: width %d, offset %d, "
+        "color %d,%d,%d,%d, pixel %d is %d,%d,%d,%d not %d,%d,%d,%d\n",
+        kernel_name, fn_name, n, offset, color.r, color.g, color.b, color.a,
+        i - GUARD, b[i].r, b[i].g, b[i].b, b[i].a, a[i].r, a[i].g, a[i].b, a[i].a);
+      break;
+    }
+  }
+  failures++;
+}
+
+
+static void check(const RasterKernels *scalar, const RasterKernels *k) {
+  /* the rows start at `base + offset`, with GUARD pixels either side */
+  static RenColor dst_a[MAX_WIDTH + GUARD * 2 + 8] __attribute__((aligned(32)));
+  static RenColor dst_b[MAX_WIDTH + GUARD * 2 + 8] __attribute__((aligned(32)));
+  static RenColor src[MAX_WIDTH + 8] __attribute__((aligned(32)));
+  static uint8_t mask[MAX_WIDTH + 32] __attribute__((aligned(32)));
+  kernel_name = k->name;
+
+  for (int round = 0; round < ROUNDS; round++) {
+    for (int n = 0; n <= MAX_WIDTH; n++) {
+      int offset = rand8() % 8;
+      RenColor color = rand_color();
+      color.a = rand_alpha();
+      for (int i = 0; i < MAX_WIDTH + GUARD * 2 + 8; i++) { dst_a[i] = rand_color(); }
+      for (int i = 0; i < MAX_WIDTH + 8; i++) {
+        src[i] = rand_color();
+        src[i].a = rand_alpha();
+      }
+      for (int i = 0; i < MAX_WIDTH + 32; i++) { mask[i] = rand_alpha(); }
+      RenColor *a = dst_a + offset, *b = dst_b + offset;
+
+      fn_name = "fill";
+      memcpy(dst_b, dst_a, sizeof(dst_b));
+      scalar->fill(a + GUARD, n, color);
+      k->fill(b + GUARD, n, color);
+      compare(a, b, n, offset, color);
+
+      fn_name = "blend";
+      memcpy(dst_b, dst_a, sizeof(dst_b));
+      scalar->blend(a + GUARD, n, color);
+      k->blend(b + GUARD, n, color);
+      compare(a, b, n, offset, color);
+
+      fn_name = "blend_image";
+      memcpy(dst_b, dst_a, sizeof(dst_b));
+      scalar->blend_image(a + GUARD, src + offset, n, color);
+      k->blend_image(b + GUARD, src + offset, n, color);
+      compare(a, b, n, offset, color);
+
+      fn_name = "blend_mask";
+      memcpy(dst_b, dst_a, sizeof(dst_b));
+      scalar->blend_mask(a + GUARD, mask + offset * 3, n, color);
+      k->blend_mask(b + GUARD, mask + offset * 3, n, color);
+      compare(a, b, n, offset, color);
+
+      if (failures) { return; }
+    }
+  }
+}
+
+
+int main(void) {
+  static const char *names[] = { "sse2", "avx2" };
+  const RasterKernels *scalar = raster_get_kernels("scalar");
+  for (int i = 0; i < 2; i++) {
+    const RasterKernels *k = raster_get_kernels(names[i]);
+    if (!k) {
+      printf("rastercheck: %s: not supported by this cpu, skipped\n", names[i]);
+      continue;
+    }
+    check(scalar, k);
+    if (failures) { return EXIT_FAILURE; }
+    printf("rastercheck: %s: matches scalar\n", names[i]);
+  }
+  return EXIT_SUCCESS;
+}
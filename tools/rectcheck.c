@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "renderer.h"
+#include "rencache.h"
+
+/* changes random scattered parts of the screen for a few hundred frames, so
+** rencache merges the changed cells into rects in every shape it can. It
+** relies on the assertion in rencache's rect building (built without NDEBUG)
+** that the rects drawn never overlap, and exits with a failure status if the
+** pixels come out different from drawing every frame in full */
+
+#define WIDTH   640
+#define HEIGHT  480
+#define FRAMES  400
+#define BOXES   40
+
+static uint32_t seed = 1;
+
+
+static int rand_int(int n) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed % n;
+}
+
+
+int main(void) {
+  static RenRect boxes[BOXES];
+  static RenColor colors[BOXES];
+  static RenColor cached[WIDTH * HEIGHT];
+  RenRect screen = { 0, 0, WIDTH, HEIGHT };
+  RenColor bg = { 0x20, 0x20, 0x20, 0xff };
+  ren_init(WIDTH, HEIGHT);
+  rencache_set_cell_size(8);
+
+  for (int frame = 0; frame < FRAMES; frame++) {
+    /* move a few boxes a frame; small ones so the changed cells are ragged */
+    for (int i = 0; i < BOXES; i++) {
+      if (frame > 0 && rand_int(4)) { continue; }
+      boxes[i] = (RenRect) { rand_int(WIDTH), rand_int(HEIGHT), 1 + rand_int(60), 1 + rand_int(40) };
+      colors[i] = (RenColor) { rand_int(256), rand_int(256), rand_int(256), 0xff };
+    }
+    rencache_begin_frame();
+    rencache_draw_rect(screen, bg);
+    for (int i = 0; i < BOXES; i++) { rencache_draw_rect(boxes[i], colors[i]); }
+    rencache_end_frame();
+
+    const RenColor *pixels = ren_get_pixels();
+    for (int i = 0; i < WIDTH * HEIGHT; i++) { cached[i] = pixels[i]; }
+    ren_set_clip_rect(screen);
+    ren_draw_rect(screen, bg);
+    for (int i = 0; i < BOXES; i++) { ren_draw_rect(boxes[i], colors[i]); }
+    for (int i = 0; i < WIDTH * HEIGHT; i++) {
+      RenColor a = cached[i], b = pixels[i];
+      if (a.r != b.r || a.g != b.g || a.b != b.b) {
+        fprintf(stderr, "rectcheck: frame %d, pixel %d,%d differs from drawing in full\n",
+          frame, i % WIDTH, i / WIDTH);
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  printf("rectcheck: %d frames, no overlapping rects\n", FRAMES);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "renderer.h"
+#include "rencache.h"
+#include "workers.h"
+#include "capture.h"
+#include "platform/platform.h"
+
+/* replays a capture written by rencache_start_capture() (see capture.h)
+** through rencache and the software renderer, without a window or Lua, and
+** prints the time each frame took along with a checksum of its pixels. The
+** cache is invalidated before every pass over the capture, so each pass ends
+** up with the same pixels on any build that draws correctly, whatever the
+** text run cache limit, cell size and thread count; tools/check.sh checks
+** that the checksums match */
+
+static FILE *fp;
+static const char *filename;
+static RenFont **fonts;
+static int font_count;
+static const char *font_dir;
+static char *text_buf;
+static int text_cap;
+
+
+static void* check_alloc(void *ptr) {
+  if (!ptr) {
+    fprintf(stderr, "Fatal error: memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  return ptr;
+}
+
+
+static void fail(const char *msg) {
+  fprintf(stderr, "Error: %s: %s\n", filename, msg);
+  exit(EXIT_FAILURE);
+}
+
+
+static void get(void *data, size_t size) {
+  if (fread(data, 1, size, fp) != size) { fail("unexpected end of file"); }
+}
+
+
+static int get_int(void) {
+  int32_t n;
+  get(&n, sizeof(n));
+  return n;
+}
+
+
+static RenRect get_rect(void) {
+  RenRect r;
+  r.x = get_int();
+  r.y = get_int();
+  r.width = get_int();
+  r.height = get_int();
+  return r;
+}
+
+
+static RenColor get_color(void) {
+  RenColor c;
+  get(&c, sizeof(c));
+  return c;
+}
+
+
+static char* get_string(int *offset) {
+  /* reads the string into text_buf at `offset` and moves the offset past
+  ** it; the pointer returned is valid until text_buf grows */
+  int len = get_int();
+  if (len < 0) { fail("bad string length"); }
+  if (*offset + len + 1 > text_cap) {
+    text_cap = (*offset + len + 1) * 2;
+    text_buf = check_alloc(realloc(text_buf, text_cap));
+  }
+  char *p = text_buf + *offset;
+  get(p, len);
+  p[len] = '\0';
+  *offset += len + 1;
+  return p;
+}
+
+
+static RenFont* get_font(void) {
+  int idx = get_int();
+  if (idx < 0 || idx >= font_count || !fonts[idx]) { fail("bad font index"); }
+  return fonts[idx];
+}
+
+
+static void load_font(void) {
+  int idx = get_int();
+  float size;
+  get(&size, sizeof(size));
+  int offset = 0;
+  char *name = get_string(&offset);
+  if (idx < 0) { fail("bad font index"); }
+  if (idx >= font_count) {
+    fonts = check_alloc(realloc(fonts, (idx + 1) * sizeof(RenFont*)));
+    memset(fonts + font_count, 0, (idx + 1 - font_count) * sizeof(RenFont*));
+    font_count = idx + 1;
+  }
+  if (fonts[idx]) { rencache_free_font(fonts[idx]); }
+  char path[4096];
+  if (font_dir) {
+    /* the same file name in another directory */
+    const char *base = strrchr(name, '/');
+    snprintf(path, sizeof(path), "%s/%s", font_dir, base ? base + 1 : name);
+    name = path;
+  }
+  fonts[idx] = ren_load_font(name, size);
+  if (!fonts[idx]) {
+    fprintf(stderr, "Error: %s: could not load font '%s'\n", filename, name);
+    exit(EXIT_FAILURE);
+  }
+}
+
+
+static void draw_tokens(void) {
+  /* the strings all go into text_buf, so they're only pointed to once it has
+  ** stopped growing */
+  static RenToken *tokens;
+  static int *offsets;
+  static int cap;
+  RenFont *font = get_font();
+  int x = get_int();
+  int y = get_int();
+  ren_set_font_tab_width(font, get_int());
+  int count = get_int();
+  if (count < 0) { fail("bad token count"); }
+  if (count > cap) {
+    cap = count;
+    tokens = check_alloc(realloc(tokens, cap * sizeof(RenToken)));
+    offsets = check_alloc(realloc(offsets, cap * sizeof(int)));
+  }
+  int offset = 0;
+  for (int i = 0; i < count; i++) {
+    tokens[i].color = get_color();
+    offsets[i] = offset;
+    get_string(&offset);
+    tokens[i].len = offset - offsets[i] - 1;
+  }
+  for (int i = 0; i < count; i++) {
+    tokens[i].text = text_buf + offsets[i];
+  }
+  rencache_draw_tokens(font, tokens, count, x, y);
+}
+
+
+static bool replay_frame(void) {
+  /* issues one frame's records; returns false at the end of the file */
+  int tag = fgetc(fp);
+  if (tag == EOF) { return false; }
+  if (tag != CAP_FRAME) { fail("expected the start of a frame"); }
+
+  int w = get_int(), h = get_int(), cw, ch;
+  ren_get_size(&cw, &ch);
+  if (w != cw || h != ch) { ren_resize(w, h); }
+  rencache_begin_frame();
+
+  for (;;) {
+    int offset = 0, idx;
+    RenRect rect;
+    RenFont *font;
+    switch (tag = fgetc(fp)) {
+      case CAP_FONT:
+        load_font();
+        break;
+      case CAP_FREE_FONT:
+        idx = get_int();
+        if (idx < 0 || idx >= font_count || !fonts[idx]) { fail("bad font index"); }
+        rencache_free_font(fonts[idx]);
+        fonts[idx] = NULL;
+        break;
+      case CAP_SCROLL:
+        rect = get_rect();
+        rencache_scroll_region(rect, get_int());
+        break;
+      case CAP_CLIP:
+        rencache_set_clip_rect(get_rect());
+        break;
+      case CAP_RECT:
+        rect = get_rect();
+        rencache_draw_rect(rect, get_color());
+        break;
+      case CAP_TEXT: {
+        font = get_font();
+        int x = get_int();
+        int y = get_int();
+        RenColor color = get_color();
+        ren_set_font_tab_width(font, get_int());
+        rencache_draw_text(font, get_string(&offset), x, y, color);
+        break;
+      }
+      case CAP_TOKENS:
+        draw_tokens();
+        break;
+      case CAP_LAYER:
+        idx = get_int();
+        rencache_begin_layer(idx, get_rect());
+        break;
+      case CAP_LAYER_END:
+        rencache_end_layer();
+        break;
+      case CAP_END_FRAME:
+        return true;
+      case EOF:
+        fail("unexpected end of file");
+        break;
+      default:
+        fail("bad record");
+    }
+  }
+}
+
+
+static uint64_t checksum(void) {
+  /* fnv-1a over the back buffer */
+  int w, h;
+  ren_get_size(&w, &h);
+  const unsigned char *p = (const unsigned char*) ren_get_pixels();
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < (size_t) w * h * sizeof(RenColor); i++) {
+    hash = (hash ^ p[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double*) a, y = *(const double*) b;
+  return x < y ? -1 : x > y;
+}
+
+
+static void usage(void) {
+  fprintf(stderr,
+    "usage: lite-replay [options] capture\n"
+    "  -n passes    replay the capture this many times (default 1)\n"
+    "  -t threads   number of threads to draw with\n"
+    "  -c size      cell size, 0 picks one from the screen size\n"
+    "  -r bytes     text run cache limit\n"
+    "  -f dir       load the capture's fonts from this directory\n"
+    "  -q           only print the summary\n");
+  exit(EXIT_FAILURE);
+}
+
+
+int main(int argc, char **argv) {
+  int passes = 1;
+  bool quiet = false;
+  for (int i = 1; i < argc; i++) {
+    if (argv[i][0] != '-') {
+      if (filename) { usage(); }
+      filename = argv[i];
+    } else if (!strcmp(argv[i], "-q")) {
+      quiet = true;
+    } else if (i + 1 < argc && !strcmp(argv[i], "-n")) {
+      passes = atoi(argv[++i]);
+    } else if (i + 1 < argc && !strcmp(argv[i], "-t")) {
+      workers_set_count(atoi(argv[++i]));
+    } else if (i + 1 < argc && !strcmp(argv[i], "-c")) {
+      rencache_set_cell_size(atoi(argv[++i]));
+    } else if (i + 1 < argc && !strcmp(argv[i], "-r")) {
+      ren_set_text_run_cache_limit(atoi(argv[++i]));
+    } else if (i + 1 < argc && !strcmp(argv[i], "-f")) {
+      font_dir = argv[++i];
+    } else {
+      usage();
+    }
+  }
+  if (!filename || passes < 1) { usage(); }
+
+  fp = fopen(filename, "rb");
+  if (!fp) {
+    fprintf(stderr, "Error: could not open '%s'\n", filename);
+    return EXIT_FAILURE;
+  }
+  char magic[sizeof(CAPTURE_MAGIC) - 1];
+  if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic)
+    || memcmp(magic, CAPTURE_MAGIC, sizeof(magic))) {
+    fail("not a capture file");
+  }
+  long data_start = ftell(fp);
+
+  ren_init(1, 1);
+  double *times = NULL;
+  int frame_count = 0, time_count = 0, time_cap = 0;
+  double total = 0, max_time = 0;
+  uint64_t all = 14695981039346656037ull;
+
+  for (int pass = 0; pass < passes; pass++) {
+    fseek(fp, data_start, SEEK_SET);
+    rencache_invalidate();
+    for (int frame = 0; replay_frame(); frame++) {
+      double start = platform_get_time();
+      rencache_end_frame();
+      double t = platform_get_time() - start;
+
+      uint64_t sum = checksum();
+      all = (all ^ sum) * 1099511628211ull;
+      if (time_count == time_cap) {
+        time_cap = time_cap ? time_cap * 2 : 256;
+        times = check_alloc(realloc(times, time_cap * sizeof(double)));
+      }
+      times[time_count++] = t;
+      total += t;
+      if (t > max_time) { max_time = t; }
+      if (pass == 0) { frame_count++; }
+
+      if (!quiet) {
+        RenCacheStats s;
+        rencache_get_stats(&s);
+        printf("%d.%d: %.3fms (hash %.3fms, draw %.3fms), %d rects, %d commands, "
+          "checksum %016llx\n", pass, frame, t * 1000, s.hash_time * 1000,
+          s.draw_time * 1000, s.rects, s.commands, (unsigned long long) sum);
+      }
+    }
+  }
+
+  if (time_count == 0) { fail("no frames"); }
+  qsort(times, time_count, sizeof(double), compare_doubles);
+  printf("%d frames x %d passes: avg %.3fms, median %.3fms, max %.3fms, "
+    "checksum %016llx\n", frame_count, passes, total / time_count * 1000,
+    times[time_count / 2] * 1000, max_time * 1000, (unsigned long long) all);
+
+  for (int i = 0; i < font_count; i++) {
+    if (fonts[i]) { ren_free_font(fonts[i]); }
+  }
+  fclose(fp);
+  return EXIT_SUCCESS;
+}
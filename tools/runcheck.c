@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "renderer.h"
+
+/* checks that text drawn through the text run cache gives the same pixels as
+** drawing it a glyph at a time: the same random strings, colors, positions
+** and clip rects are drawn with the cache at its default size, with a cache
+** small enough that runs keep being evicted, and with the cache off. Some
+** strings are past the length runs are cached up to, some have glyphs whose
+** edges touch. Run from the repo's root, as it loads the fonts in data/fonts.
+** Exits with a failure status if the pixels differ */
+
+#define WIDTH   640
+#define HEIGHT  480
+#define DRAWS   3000
+
+static const char *font_files[] = { "data/fonts/font.ttf", "data/fonts/monospace.ttf" };
+static const float font_sizes[] = { 14, 13.5, 30 };
+static const char *words[] = {
+  "int", "return", "//", "ff", "fi", "WAVy", "__", "--", "==", "Tj", "\"q@",
+  "(x)", "{}", "1234567890", "\t", " ", "lite", "AVA", "|||", "%%"
+};
+static uint32_t seed = 1;
+
+
+static int rand_int(int n) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed % n;
+}
+
+
+static void draw_all(RenFont **fonts, int font_count) {
+  /* draws the same things every time it's called */
+  static char text[1024];
+  seed = 1;
+  RenRect screen = { 0, 0, WIDTH, HEIGHT };
+  ren_set_clip_rect(screen);
+  ren_draw_rect(screen, (RenColor) { 0x20, 0x20, 0x20, 0xff });
+  for (int i = 0; i < DRAWS; i++) {
+    /* a few strings are drawn over and over, so the cache gets hits */
+    int n = rand_int(4) ? 1 + rand_int(3) : 1 + rand_int(60);
+    uint32_t saved = seed;
+    if (rand_int(2)) { seed = 1 + rand_int(16); }
+    text[0] = '\0';
+    for (int j = 0; j < n; j++) { strcat(text, words[rand_int(sizeof(words) / sizeof(*words))]); }
+    seed = saved;
+
+    RenFont *font = fonts[rand_int(font_count)];
+    RenColor color = { rand_int(256), rand_int(256), rand_int(256), rand_int(4) ? 0xff : rand_int(256) };
+    RenRect clip = screen;
+    if (rand_int(4) == 0) {
+      /* the renderer expects the clip rect to be within the screen */
+      clip.x = rand_int(WIDTH);
+      clip.y = rand_int(HEIGHT);
+      clip.width = rand_int(WIDTH - clip.x + 1);
+      clip.height = rand_int(HEIGHT - clip.y + 1);
+    }
+    ren_set_clip_rect(clip);
+    ren_draw_text(font, text, rand_int(WIDTH) - 100, rand_int(HEIGHT) - 20, color, 8 * (1 + rand_int(4)));
+  }
+}
+
+
+int main(void) {
+  static RenColor cached[WIDTH * HEIGHT];
+  static const int limits[] = { 64 * 1024, 0 };
+  RenFont *fonts[6];
+  int font_count = 0;
+  ren_init(WIDTH, HEIGHT);
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 3; j++) {
+      fonts[font_count] = ren_load_font(font_files[i], font_sizes[j]);
+      if (!fonts[font_count]) {
+        fprintf(stderr, "runcheck: could not load '%s', run from the repo's root\n", font_files[i]);
+        return EXIT_FAILURE;
+      }
+      font_count++;
+    }
+  }
+
+  draw_all(fonts, font_count);
+  memcpy(cached, ren_get_pixels(), sizeof(cached));
+  RenStats stats;
+  ren_get_stats(&stats);
+  printf("runcheck: %d text run hits, %d misses\n", stats.text_run_hits, stats.text_run_misses);
+  fflush(stdout);
+
+  for (int i = 0; i < 2; i++) {
+    ren_set_text_run_cache_limit(limits[i]);
+    draw_all(fonts, font_count);
+    const RenColor *pixels = ren_get_pixels();
+    for (int j = 0; j < WIDTH * HEIGHT; j++) {
+      if (memcmp(&cached[j], &pixels[j], sizeof(RenColor))) {
+        fprintf(stderr, "runcheck: with a text run cache of %d bytes, pixel %d,%d differs "
+          "from the default cache\n", limits[i], j % WIDTH, j / WIDTH);
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  printf("runcheck: cached text matches drawing it a glyph at a time\n");
+  return EXIT_SUCCESS;
+}